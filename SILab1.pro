@@ -2,16 +2,36 @@ TEMPLATE = app
 CONFIG += console
 CONFIG -= app_bundle
 CONFIG -= qt
+CONFIG += thread
+
+# Shared memory telemetry
+LIBS += -lrt
 
 QMAKE_CXXFLAGS += -std=gnu++1z
 
+# Debug builds report heap allocations made after the first generation
+CONFIG(debug, debug|release): DEFINES += GA_COUNT_ALLOCATIONS
+
 SOURCES += \
         main.cpp \
     matrix.cpp \
     error.cpp \
     factoryproblem.cpp \
+    factoryinstance.cpp \
     randomsearch.cpp \
-    greedysearch.cpp
+    greedysearch.cpp \
+    allocationcounter.cpp \
+    qaplib.cpp \
+    scalingbenchmark.cpp \
+    paralleltempering.cpp \
+    factorygenetic.cpp \
+    timetotarget.cpp \
+    binaryproblem.cpp \
+    telemetry.cpp \
+    fusedbenchmark.cpp \
+    elitearchive.cpp \
+    racing.cpp \
+    solverdaemon.cpp
 
 DISTFILES += \
     had12.dat \
@@ -24,8 +44,24 @@ HEADERS += \
     geneticalgorithm.h \
     matrix.h\
     factoryproblem.h \
+    factoryinstance.h \
+    factorykernels.h \
     generics.h \
     randomservice.h \
+    bulkrandom.h \
     randomsearch.h \
-    greedysearch.h
+    greedysearch.h \
+    allocationcounter.h \
+    scratcharena.h \
+    qaplib.h \
+    scalingbenchmark.h \
+    paralleltempering.h \
+    factorygenetic.h \
+    timetotarget.h \
+    binaryproblem.h \
+    telemetry.h \
+    fusedbenchmark.h \
+    elitearchive.h \
+    racing.h \
+    solverdaemon.h
 
@@ -0,0 +1,26 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+#include <cstddef>
+
+// Counts heap allocations made by the calling thread. Global operator new is
+// replaced only in builds defining GA_COUNT_ALLOCATIONS (debug builds), in
+// other builds count() always returns 0.
+namespace AllocationCounter {
+size_t count();
+}
+
+#endif // ALLOCATIONCOUNTER_H
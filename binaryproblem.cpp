@@ -0,0 +1,197 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "binaryproblem.h"
+#include "bulkrandom.h"
+#include "scratcharena.h"
+#include <algorithm>
+#include <random>
+
+namespace {
+// Mask of valid bits in the last word
+uint64_t lastWordMask(size_t numberOfBits) {
+    return numberOfBits % 64 == 0 ? ~uint64_t(0) : (uint64_t(1) << (numberOfBits % 64)) - 1;
+}
+
+// Resizing a recycled child keeps its storage
+void prepareChild(const BinaryProblem::BinaryChromosome& parent, BinaryProblem::BinaryChromosome& child) {
+    child.fenotype.numberOfBits = parent.fenotype.numberOfBits;
+    child.fenotype.words.resize(parent.fenotype.words.size());
+    child.lastEvaluation = 0;
+}
+
+// Children take bits of parents where mask is set and of the other parent
+// elsewhere
+inline void crossWord(size_t word, uint64_t mask,
+    const BinaryProblem::BinaryChromosome& parent1, const BinaryProblem::BinaryChromosome& parent2,
+    BinaryProblem::BinaryChromosome& child1, BinaryProblem::BinaryChromosome& child2) {
+    const uint64_t word1 = parent1.fenotype.words[word];
+    const uint64_t word2 = parent2.fenotype.words[word];
+    child1.fenotype.words[word] = (word1 & mask) | (word2 & ~mask);
+    child2.fenotype.words[word] = (word2 & mask) | (word1 & ~mask);
+}
+} // namespace
+
+BinaryProblem::KnapsackInstance BinaryProblem::KnapsackInstance::generate(size_t numberOfItems, uint64_t seed) {
+    std::mt19937_64 engine(seed);
+    std::uniform_int_distribution<uint32_t> value(1, 1000);
+
+    KnapsackInstance instance;
+    uint64_t totalWeight = 0;
+    for (size_t item = 0; item < numberOfItems; item++) {
+        instance.weights.push_back(value(engine));
+        instance.values.push_back(value(engine));
+        totalWeight += instance.weights.back();
+    }
+    instance.capacity = totalWeight / 2;
+    return instance;
+}
+
+//  Init function
+std::function<BinaryProblem::BinaryChromosome(void)>
+BinaryProblem::getBinaryRandomInitializationFunction(size_t numberOfBits) {
+    return [numberOfBits]() {
+        BinaryFenotype fenotype(numberOfBits);
+        BulkRandom::local().fill(fenotype.words.data(), fenotype.words.size());
+        if (!fenotype.words.empty())
+            fenotype.words.back() &= lastWordMask(numberOfBits);
+
+        return BinaryChromosome(fenotype, 0);
+    };
+}
+
+//  Evaluation functions
+std::function<BinaryProblem::BinaryEval(BinaryProblem::BinaryChromosome&)>
+BinaryProblem::getOneMaxEvaluationFunction() {
+    return [](BinaryChromosome& chromosome) {
+        BinaryEval ones = 0;
+        for (const uint64_t word : chromosome.fenotype.words) {
+            ones += __builtin_popcountll(word);
+        }
+        chromosome.lastEvaluation = ones;
+        return chromosome.lastEvaluation;
+    };
+}
+
+std::function<BinaryProblem::BinaryEval(BinaryProblem::BinaryChromosome&)>
+BinaryProblem::getKnapsackEvaluationFunction(const KnapsackInstance& instance) {
+    // Items are padded to whole words, so the kernel needs no tail handling
+    const size_t paddedItems = (instance.weights.size() + 63) / 64 * 64;
+    std::vector<uint32_t> weights(instance.weights);
+    std::vector<uint32_t> values(instance.values);
+    weights.resize(paddedItems);
+    values.resize(paddedItems);
+
+    return [weights, values, capacity = instance.capacity](BinaryChromosome& chromosome) {
+        uint64_t weight = 0;
+        uint64_t value = 0;
+
+        const std::vector<uint64_t>& words = chromosome.fenotype.words;
+        for (size_t word = 0; word < words.size(); word++) {
+            const uint64_t bits = words[word];
+            if (bits == 0)
+                continue;
+
+            // Bits are expanded to all ones or all zeros masks, fixed length
+            // loop without branches is vectorised
+            const uint32_t* wordWeights = weights.data() + word * 64;
+            const uint32_t* wordValues = values.data() + word * 64;
+            uint32_t wordWeight = 0;
+            uint32_t wordValue = 0;
+            for (uint32_t bit = 0; bit < 64; bit++) {
+                const uint32_t mask = -static_cast<uint32_t>((bits >> bit) & 1U);
+                wordWeight += wordWeights[bit] & mask;
+                wordValue += wordValues[bit] & mask;
+            }
+            weight += wordWeight;
+            value += wordValue;
+        }
+
+        // Overweight solutions lose more than any item could give
+        const uint64_t overweight = weight > capacity ? weight - capacity : 0;
+        chromosome.lastEvaluation = static_cast<BinaryEval>(value) - static_cast<BinaryEval>(overweight * 1000);
+        return chromosome.lastEvaluation;
+    };
+}
+
+//  Crossing
+void BinaryProblem::binaryInPlaceUniformCrossingFunction(
+    const BinaryChromosome& parent1, const BinaryChromosome& parent2,
+    BinaryChromosome& child1, BinaryChromosome& child2) {
+    prepareChild(parent1, child1);
+    prepareChild(parent1, child2);
+
+    // One random word decides 64 genes
+    BulkRandom& random = BulkRandom::local();
+    for (size_t word = 0; word < parent1.fenotype.words.size(); word++) {
+        crossWord(word, random.next(), parent1, parent2, child1, child2);
+    }
+}
+
+std::function<void(const BinaryProblem::BinaryChromosome&, const BinaryProblem::BinaryChromosome&,
+    BinaryProblem::BinaryChromosome&, BinaryProblem::BinaryChromosome&)>
+BinaryProblem::getBinaryInPlaceNPointCrossingFunction(size_t points) {
+    return [points](const BinaryChromosome& parent1, const BinaryChromosome& parent2,
+               BinaryChromosome& child1, BinaryChromosome& child2) {
+        prepareChild(parent1, child1);
+        prepareChild(parent1, child2);
+
+        const size_t numberOfBits = parent1.fenotype.numberOfBits;
+        if (numberOfBits == 0)
+            return;
+
+        std::vector<uint64_t>& cuts = ScratchArena<uint64_t>::local().buffer(0);
+        BulkRandom& random = BulkRandom::local();
+        for (size_t point = 0; point < points; point++) {
+            cuts.push_back(random.nextBelow(static_cast<uint32_t>(numberOfBits)));
+        }
+        std::sort(std::begin(cuts), std::end(cuts));
+        cuts.push_back(numberOfBits);
+
+        // Segments alternate between parents, words inside a segment are
+        // copied whole and only words holding a cut are masked
+        bool fromFirst = true;
+        size_t start = 0;
+        for (const uint64_t cut : cuts) {
+            for (size_t bit = start; bit < cut;) {
+                const size_t word = bit / 64;
+                const size_t end = std::min<size_t>(cut, (word + 1) * 64);
+                const uint64_t high = end % 64 == 0 ? ~uint64_t(0) : (uint64_t(1) << (end % 64)) - 1;
+                const uint64_t mask = high & (~uint64_t(0) << (bit % 64));
+
+                const uint64_t taken = fromFirst ? mask : 0;
+                const uint64_t word1 = parent1.fenotype.words[word];
+                const uint64_t word2 = parent2.fenotype.words[word];
+                child1.fenotype.words[word] = (child1.fenotype.words[word] & ~mask) | (((word1 & taken) | (word2 & ~taken)) & mask);
+                child2.fenotype.words[word] = (child2.fenotype.words[word] & ~mask) | (((word2 & taken) | (word1 & ~taken)) & mask);
+                bit = end;
+            }
+            fromFirst = !fromFirst;
+            start = cut;
+        }
+    };
+}
+
+//  Mutating
+std::function<void(BinaryProblem::BinaryChromosome&)>
+BinaryProblem::getBinaryBitFlipMutationFunction(double bitProbability) {
+    return [skip = GeometricSkip(bitProbability)](BinaryChromosome& object) {
+        // Jump straight to flipping bits
+        BulkRandom& random = BulkRandom::local();
+        const size_t numberOfBits = object.fenotype.numberOfBits;
+        for (size_t bit = skip.first(random); bit < numberOfBits; bit = skip.next(bit, random)) {
+            object.fenotype.flip(bit);
+        }
+    };
+}
@@ -0,0 +1,65 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef BINARYPROBLEM_H
+#define BINARYPROBLEM_H
+#include "geneticalgorithm.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Binary encoded problems, genes are packed 64 to a word and operators work
+// on whole words. Bits past numberOfBits in the last word are always zero.
+namespace BinaryProblem {
+struct BinaryFenotype {
+    BinaryFenotype(size_t numberOfBits)
+        : words((numberOfBits + 63) / 64), numberOfBits(numberOfBits) {
+    }
+
+    bool get(size_t bit) const { return (words[bit / 64] >> (bit % 64)) & 1U; }
+    void flip(size_t bit) { words[bit / 64] ^= uint64_t(1) << (bit % 64); }
+
+    std::vector<uint64_t> words;
+    size_t numberOfBits;
+};
+
+using BinaryEval = int64_t;
+using BinaryChromosome = Chromosome<BinaryFenotype, BinaryEval>;
+
+// 0/1 knapsack, items beyond capacity are penalised
+struct KnapsackInstance {
+    std::vector<uint32_t> weights;
+    std::vector<uint32_t> values;
+    uint64_t capacity;
+
+    // Weights and values in [1, 1000], capacity is half of total weight
+    static KnapsackInstance generate(size_t numberOfItems, uint64_t seed);
+};
+
+// Initialization
+std::function<BinaryChromosome(void)> getBinaryRandomInitializationFunction(size_t numberOfBits);
+
+// Evaluation
+std::function<BinaryEval(BinaryChromosome&)> getOneMaxEvaluationFunction();
+std::function<BinaryEval(BinaryChromosome&)> getKnapsackEvaluationFunction(const KnapsackInstance& instance);
+
+// Crossings, children are written into given chromosomes
+void binaryInPlaceUniformCrossingFunction(const BinaryChromosome& parent1, const BinaryChromosome& parent2, BinaryChromosome& child1, BinaryChromosome& child2);
+std::function<void(const BinaryChromosome&, const BinaryChromosome&, BinaryChromosome&, BinaryChromosome&)> getBinaryInPlaceNPointCrossingFunction(size_t points);
+
+// Mutation, every bit flips with bitProbability
+std::function<void(BinaryChromosome&)> getBinaryBitFlipMutationFunction(double bitProbability);
+} // namespace BinaryProblem
+
+#endif // BINARYPROBLEM_H
@@ -0,0 +1,149 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef BULKRANDOM_H
+#define BULKRANDOM_H
+#include "randomservice.h"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Generator producing numbers in blocks. State is kept as independent
+// xoshiro256+ streams laid out lane by lane, so one refill updates all lanes
+// with the same instructions and is vectorised by the compiler.
+class BulkRandom {
+public:
+    static constexpr size_t LANES = 8;
+    static constexpr size_t BLOCK_SIZE = 64 * LANES;
+
+    explicit BulkRandom(uint64_t seed) { this->seed(seed); }
+
+    // One generator per thread, seeded from the thread's RandomService
+    static BulkRandom& local() {
+        thread_local BulkRandom random(RandomService::getService().getEngine()());
+        return random;
+    }
+
+    void seed(uint64_t seed) {
+        // Lanes are seeded by splitmix64 as recommended for xoshiro
+        for (size_t word = 0; word < 4; word++) {
+            for (size_t lane = 0; lane < LANES; lane++) {
+                seed += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = seed;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                state[word][lane] = z ^ (z >> 31);
+            }
+        }
+        position = BLOCK_SIZE;
+    }
+
+    uint64_t next() {
+        if (position == BLOCK_SIZE)
+            refill();
+        return block[position++];
+    }
+
+    // Uniform in [0, 1)
+    double nextDouble() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+    // Uniform in [0, range) without modulo bias (Lemire's multiply and shift),
+    // empty range gives 0
+    uint32_t nextBelow(uint32_t range) {
+        uint64_t product = (next() >> 32) * range;
+        uint32_t low = static_cast<uint32_t>(product);
+        // Never taken for empty range, so the remainder below does not divide by 0
+        if (low < range) {
+            const uint32_t threshold = static_cast<uint32_t>(-range) % range;
+            while (low < threshold) {
+                product = (next() >> 32) * range;
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return static_cast<uint32_t>(product >> 32);
+    }
+
+    void fill(uint64_t* out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = next();
+        }
+    }
+
+    // Uniform in [0, 1)
+    void fill(float* out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = static_cast<float>(next() >> 40) * 0x1.0p-24f;
+        }
+    }
+
+private:
+    void refill() {
+        for (size_t round = 0; round < BLOCK_SIZE / LANES; round++) {
+            uint64_t* out = block + round * LANES;
+            for (size_t lane = 0; lane < LANES; lane++) {
+                out[lane] = state[0][lane] + state[3][lane];
+
+                const uint64_t t = state[1][lane] << 17;
+                state[2][lane] ^= state[0][lane];
+                state[3][lane] ^= state[1][lane];
+                state[1][lane] ^= state[2][lane];
+                state[0][lane] ^= state[3][lane];
+                state[2][lane] ^= t;
+                state[3][lane] = (state[3][lane] << 45) | (state[3][lane] >> 19);
+            }
+        }
+        position = 0;
+    }
+
+    alignas(64) uint64_t state[4][LANES];
+    alignas(64) uint64_t block[BLOCK_SIZE];
+    size_t position;
+};
+
+// Geometric skip sampling, instead of one Bernoulli draw per item only items
+// that succeed are visited. Gap between successes with probability p is
+// floor(log(U) / log(1 - p)) for U uniform in (0, 1].
+class GeometricSkip {
+public:
+    explicit GeometricSkip(double probability)
+        : logComplement(probability >= 1.0 ? -std::numeric_limits<double>::infinity()
+                                           : std::log1p(-probability)),
+          never(probability <= 0.0) {
+    }
+
+    // Index of first success
+    size_t first(BulkRandom& random) const { return skip(random); }
+
+    // Index of success after the one at index
+    size_t next(size_t index, BulkRandom& random) const {
+        const size_t gap = skip(random);
+        return gap >= std::numeric_limits<size_t>::max() - index ? std::numeric_limits<size_t>::max()
+                                                                 : index + 1 + gap;
+    }
+
+private:
+    size_t skip(BulkRandom& random) const {
+        if (never)
+            return std::numeric_limits<size_t>::max();
+        const double gap = std::floor(std::log(1.0 - random.nextDouble()) / logComplement);
+        return gap >= static_cast<double>(std::numeric_limits<size_t>::max() / 2)
+            ? std::numeric_limits<size_t>::max()
+            : static_cast<size_t>(gap);
+    }
+
+    const double logComplement;
+    const bool never;
+};
+
+#endif // BULKRANDOM_H
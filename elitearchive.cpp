@@ -0,0 +1,204 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "elitearchive.h"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <map>
+#include <sstream>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// Holds an flock for the lifetime of the object
+class FileLock {
+public:
+    FileLock(const std::string& path, int flags, int operation) {
+        for (;;) {
+            descriptor = open(path.c_str(), flags, 0644);
+            if (descriptor < 0)
+                return;
+            if (flock(descriptor, operation) != 0) {
+                close(descriptor);
+                descriptor = -1;
+                return;
+            }
+
+            // Compaction may have renamed a new file over the path while
+            // waiting, the lock then belongs to the replaced one
+            struct stat locked;
+            struct stat current;
+            if (fstat(descriptor, &locked) == 0 && stat(path.c_str(), &current) == 0
+                && locked.st_dev == current.st_dev && locked.st_ino == current.st_ino)
+                return;
+            close(descriptor);
+        }
+    }
+    ~FileLock() {
+        if (descriptor >= 0)
+            close(descriptor); // Releases the lock
+    }
+    FileLock(const FileLock&) = delete;
+    void operator=(const FileLock&) = delete;
+
+    int get() const { return descriptor; }
+
+private:
+    int descriptor = -1;
+};
+
+std::string readAll(int descriptor) {
+    std::string content;
+    char buffer[1 << 16];
+    ssize_t read = 0;
+    while ((read = ::read(descriptor, buffer, sizeof(buffer))) > 0)
+        content.append(buffer, static_cast<size_t>(read));
+    return content;
+}
+
+bool writeAll(int descriptor, const std::string& content) {
+    return content.empty() || write(descriptor, content.data(), content.size()) == static_cast<ssize_t>(content.size());
+}
+
+// Cheapest first, duplicates of a permutation are dropped
+void keepBest(std::vector<EliteArchive::Entry>& entries, size_t k) {
+    std::sort(std::begin(entries), std::end(entries), [](const auto& a, const auto& b) {
+        return a.cost != b.cost ? a.cost < b.cost : a.locations < b.locations;
+    });
+    entries.erase(std::unique(std::begin(entries), std::end(entries),
+                      [](const auto& a, const auto& b) { return a.locations == b.locations; }),
+        std::end(entries));
+    if (entries.size() > k)
+        entries.resize(k);
+}
+
+// Valid entries by instance checksum and size, with the count of all lines
+struct Contents {
+    std::map<std::pair<uint64_t, size_t>, std::vector<EliteArchive::Entry>> instances;
+    size_t lines = 0;
+};
+
+Contents parse(const std::string& content) {
+    Contents contents;
+    std::istringstream lines(content);
+    std::string line;
+    while (std::getline(lines, line)) {
+        contents.lines++;
+        std::istringstream fields(line);
+        uint64_t checksum = 0;
+        size_t size = 0;
+        EliteArchive::Entry entry;
+        if (!(fields >> std::hex >> checksum >> std::dec >> entry.cost >> size) || size == 0 || size > (1U << 24))
+            continue;
+
+        // Torn or foreign lines are skipped, only valid permutations are kept
+        entry.locations.resize(size);
+        std::vector<bool> seen(size);
+        bool valid = true;
+        for (size_t i = 0; i < size && valid; i++) {
+            valid = static_cast<bool>(fields >> entry.locations[i]) && entry.locations[i] < size && !seen[entry.locations[i]];
+            if (valid)
+                seen[entry.locations[i]] = true;
+        }
+        if (valid)
+            contents.instances[{ checksum, size }].push_back(std::move(entry));
+    }
+    return contents;
+}
+
+std::string format(uint64_t checksum, const EliteArchive::Entry& entry) {
+    std::ostringstream line;
+    line << std::hex << checksum << std::dec << " " << entry.cost << " " << entry.locations.size();
+    for (const uint location : entry.locations)
+        line << " " << location;
+    line << "\n";
+    return line.str();
+}
+
+// Best k of every instance written to a new file renamed over the archive,
+// readers and writers holding the old file retry on the new one
+bool compact(const std::string& path, Contents& contents, size_t k) {
+    std::string content;
+    for (auto& instance : contents.instances) {
+        keepBest(instance.second, k);
+        for (const EliteArchive::Entry& entry : instance.second)
+            content += format(instance.first.first, entry);
+    }
+
+    const std::string temporaryPath = path + ".tmp";
+    const int descriptor = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0)
+        return false;
+    const bool written = writeAll(descriptor, content) && fsync(descriptor) == 0;
+    close(descriptor);
+    if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+std::vector<EliteArchive::Entry> EliteArchive::load(const std::string& path, uint64_t checksum, size_t size, size_t k) {
+    const FileLock lock(path, O_RDONLY, LOCK_SH);
+    if (lock.get() < 0)
+        return {};
+
+    Contents contents = parse(readAll(lock.get()));
+    std::vector<Entry>& entries = contents.instances[{ checksum, size }];
+    keepBest(entries, k);
+    return std::move(entries);
+}
+
+bool EliteArchive::store(const std::string& path, uint64_t checksum, const std::vector<Entry>& entries, size_t k) {
+    if (entries.empty())
+        return true;
+
+    // Reading and appending under one lock, so two runs do not store the same permutation
+    const FileLock lock(path, O_RDWR | O_CREAT | O_APPEND, LOCK_EX);
+    if (lock.get() < 0)
+        return false;
+
+    const size_t size = entries.front().locations.size();
+    Contents contents = parse(readAll(lock.get()));
+    std::vector<Entry>& archived = contents.instances[{ checksum, size }];
+    keepBest(archived, k);
+
+    std::string lines;
+    size_t appended = 0;
+    for (const Entry& entry : entries) {
+        const bool known = std::any_of(std::begin(archived), std::end(archived),
+            [&entry](const Entry& other) { return other.locations == entry.locations; });
+        const bool good = archived.size() < k || entry.cost < archived.back().cost;
+        if (known || !good || entry.locations.size() != size)
+            continue;
+
+        lines += format(checksum, entry);
+        appended++;
+        archived.push_back(entry);
+        keepBest(archived, k);
+    }
+
+    // Superseded lines are dropped once they outnumber the kept ones
+    size_t kept = 0;
+    for (const auto& instance : contents.instances)
+        kept += std::min(instance.second.size(), k);
+    if (contents.lines + appended > std::max(COMPACTION_LINES, COMPACTION_FACTOR * kept))
+        return compact(path, contents, k);
+
+    // One write, so a line is never interleaved with another writer
+    return writeAll(lock.get(), lines);
+}
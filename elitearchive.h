@@ -0,0 +1,44 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef ELITEARCHIVE_H
+#define ELITEARCHIVE_H
+#include "factoryinstance.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Best permutations of past runs, kept in one text file shared by all
+// instances. Every line is "checksum cost size locations...", lines are
+// appended under an exclusive flock, so concurrent runs do not mix them. When
+// the file grows past COMPACTION_LINES and COMPACTION_FACTOR times the lines
+// still among the best k, the best k of every instance are written to a new
+// file renamed over it.
+namespace EliteArchive {
+constexpr size_t COMPACTION_LINES = 256;
+constexpr size_t COMPACTION_FACTOR = 2;
+
+struct Entry {
+    FactoryProblem::FactoryCost cost = 0;
+    std::vector<uint> locations;
+};
+
+// Best k distinct permutations of the instance, cheapest first
+std::vector<Entry> load(const std::string& path, uint64_t checksum, size_t size, size_t k);
+
+// Appends entries that would enter the best k, returns false when the file is not writable
+bool store(const std::string& path, uint64_t checksum, const std::vector<Entry>& entries, size_t k);
+} // namespace EliteArchive
+
+#endif // ELITEARCHIVE_H
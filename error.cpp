@@ -15,4 +15,6 @@
 enum class Error {
     NO_ERROR = 0,
     FILE_NOT_FOUND = 1,
+    PARSE_ERROR = 2,
+    INVALID_ARGUMENTS = 3,
 };
@@ -0,0 +1,101 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "factorygenetic.h"
+#include "generics.h"
+#include <cassert>
+
+std::string FactoryProblem::crossoverKindToString(CrossoverKind kind) {
+    switch (kind) {
+    case CrossoverKind::OX:
+        return "ox";
+    case CrossoverKind::SYMETRIC_OX:
+        return "symetric-ox";
+    }
+    return "";
+}
+
+bool FactoryProblem::isValid(const GeneticConfiguration& configuration) {
+    return !configuration.adaptivePopulationSize || !(configuration.fused || configuration.screening);
+}
+
+FactoryProblem::FactoryChromosome FactoryProblem::runGeneticAlgorithm(const FactoryInstance& instance,
+    const GeneticConfiguration& configuration,
+    StopCondition<FactoryFenotype, FactoryEval>& stopCondition,
+    LoggingFunction<FactoryFenotype, FactoryEval>& loggingFunction,
+    ScreeningCounters* screeningCounters) {
+    using Fenotype = FactoryFenotype;
+    using Eval = FactoryEval;
+    assert(isValid(configuration));
+
+    const size_t matrixSize = instance.size();
+    const auto crossingFunction = configuration.crossover == CrossoverKind::OX
+        ? factoryInPlaceOXCrossingFunction
+        : factoryInPlaceSymetricOXCrossingFunction;
+
+    const size_t seededCount = static_cast<size_t>(configuration.seededFraction * configuration.populationSize);
+    GenericRandomInitializationFunction<Fenotype, Eval> initializationFunction(configuration.populationSize, matrixSize,
+        configuration.seeds.empty()
+            ? getFactoryRandomInitializationFunction(matrixSize)
+            : getFactorySeededInitializationFunction(matrixSize, configuration.seeds, seededCount));
+    ScreeningCounters localCounters;
+    GenericEvaluationFunction<Fenotype, Eval> evaluationFunction(getFactoryEvaluationFunction(instance), getFactoryDiversityFunction(matrixSize),
+        configuration.screening ? getFactoryOffspringScreeningFunction(instance, screeningCounters ? *screeningCounters : localCounters) : nullptr);
+
+    // Adaptive runs scale the tournament with the population, a fixed one
+    // would amount to picking the best chromosome once the population shrinks
+    GenericTournamentSelectionFunction<Fenotype, Eval> selectionFunction(configuration.tournamentSize,
+        configuration.adaptivePopulationSize ? configuration.populationSize : 0);
+    GenericCrossoverFunction<Fenotype, Eval> crossoverFunction(configuration.crossingProbability, crossingFunction);
+    GenericMutationFunction<Fenotype, Eval> mutationFunction(configuration.mutatingProbability, factorySwapMuatationFunction);
+
+    if (configuration.fused || configuration.screening) {
+        return GeneticAlgorithm<Fenotype, Eval>::optimizeFused(
+            initializationFunction,
+            evaluationFunction,
+            stopCondition,
+            loggingFunction,
+
+            selectionFunction,
+            crossoverFunction,
+            mutationFunction,
+            configuration.screening);
+    }
+
+    if (configuration.adaptivePopulationSize) {
+        GenericAdaptivePopulationSizeFunction<Fenotype, Eval> populationSizeFunction(
+            configuration.minPopulationSize, configuration.maxPopulationSize, getFactoryRandomReinitializationFunction());
+
+        return GeneticAlgorithm<Fenotype, Eval>::optimize(
+            initializationFunction,
+            evaluationFunction,
+            stopCondition,
+            loggingFunction,
+
+            selectionFunction,
+            crossoverFunction,
+            mutationFunction,
+            populationSizeFunction);
+    }
+
+    return GeneticAlgorithm<Fenotype, Eval>::optimize(
+        initializationFunction,
+        evaluationFunction,
+        stopCondition,
+        loggingFunction,
+
+        selectionFunction,
+        crossoverFunction,
+        mutationFunction);
+}
@@ -0,0 +1,68 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef FACTORYGENETIC_H
+#define FACTORYGENETIC_H
+#include "factoryinstance.h"
+#include "factoryproblem.h"
+#include "geneticalgorithm.h"
+#include <string>
+#include <vector>
+
+// Genetic algorithm assembled from the factory operators
+namespace FactoryProblem {
+enum class CrossoverKind {
+    OX,
+    SYMETRIC_OX,
+};
+
+struct GeneticConfiguration {
+    size_t populationSize = 100;
+    size_t tournamentSize = 100;
+    double crossingProbability = 0.70;
+    double mutatingProbability = 0.20;
+    CrossoverKind crossover = CrossoverKind::SYMETRIC_OX;
+
+    // Population starts at populationSize and is resized between the bounds,
+    // tournament keeps the share of the population it has at populationSize
+    bool adaptivePopulationSize = false;
+    size_t minPopulationSize = 20;
+    size_t maxPopulationSize = 1000;
+
+    // Builds each offspring from selection to evaluation in one go, population size stays fixed
+    bool fused = false;
+    // Fused pipeline with offspring costing more than the worst chromosome of
+    // the current generation dropped after partial evaluation
+    bool screening = false;
+
+    // Known good permutations, seededFraction of the initial population starts from them
+    std::vector<std::vector<uint>> seeds;
+    double seededFraction = 0.25;
+};
+
+std::string crossoverKindToString(CrossoverKind kind);
+
+// Fused and screening runs keep population size fixed, adaptive sizing cannot
+// be combined with them
+bool isValid(const GeneticConfiguration& configuration);
+
+// Configuration must be valid. Work of screening is added to screeningCounters when given
+FactoryChromosome runGeneticAlgorithm(const FactoryInstance& instance,
+    const GeneticConfiguration& configuration,
+    StopCondition<FactoryFenotype, FactoryEval>& stopCondition,
+    LoggingFunction<FactoryFenotype, FactoryEval>& loggingFunction,
+    ScreeningCounters* screeningCounters = nullptr);
+} // namespace FactoryProblem
+
+#endif // FACTORYGENETIC_H
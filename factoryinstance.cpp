@@ -0,0 +1,54 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "factoryinstance.h"
+#include "factorykernels.h"
+#include <limits>
+
+namespace {
+template <class Element>
+std::shared_ptr<const FactoryProblem::FactoryKernels> makeKernels(
+    const Matrix<uint>& distanceMatrix, const Matrix<uint>& flowMatrix, bool symmetric, bool sparse) {
+    using namespace FactoryProblem;
+    // Packed distances take half of the memory of full ones, CSR flows little,
+    // but halve sparse evaluation speed, so only large instances use them
+    const size_t distanceBytes = distanceMatrix.rows * distanceMatrix.cols * sizeof(Element);
+    if (sparse && distanceBytes > FactoryInstance::PACKED_DISTANCE_BYTES && distanceMatrix.isSymmetric())
+        return std::make_shared<SparseFactoryKernels<Element, SymmetricMatrix<Element>>>(distanceMatrix, flowMatrix);
+    if (sparse)
+        return std::make_shared<SparseFactoryKernels<Element>>(distanceMatrix, flowMatrix);
+    if (symmetric)
+        return std::make_shared<SymmetricFactoryKernels<Element>>(distanceMatrix, flowMatrix);
+    return std::make_shared<DenseFactoryKernels<Element>>(distanceMatrix, flowMatrix);
+}
+} // namespace
+
+FactoryProblem::FactoryInstance::FactoryInstance(
+    const Matrix<uint>& distanceMatrix, const Matrix<uint>& flowMatrix)
+    : matrixSize(distanceMatrix.rows),
+      symmetric(distanceMatrix.isSymmetric() && flowMatrix.isSymmetric()),
+      sparse(flowMatrix.nonZeros() <= SPARSE_DENSITY * flowMatrix.rows * flowMatrix.cols) {
+    const uint maxElement = std::max(distanceMatrix.maxElement(), flowMatrix.maxElement());
+
+    if (maxElement <= std::numeric_limits<uint8_t>::max()) {
+        bytesPerElement = sizeof(uint8_t);
+        factoryKernels = makeKernels<uint8_t>(distanceMatrix, flowMatrix, symmetric, sparse);
+    } else if (maxElement <= std::numeric_limits<uint16_t>::max()) {
+        bytesPerElement = sizeof(uint16_t);
+        factoryKernels = makeKernels<uint16_t>(distanceMatrix, flowMatrix, symmetric, sparse);
+    } else {
+        bytesPerElement = sizeof(uint32_t);
+        factoryKernels = makeKernels<uint32_t>(distanceMatrix, flowMatrix, symmetric, sparse);
+    }
+}
@@ -0,0 +1,82 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef FACTORYINSTANCE_H
+#define FACTORYINSTANCE_H
+#include "matrix.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace FactoryProblem {
+// Objective values are accumulated in 64 bits, products of two 32 bit
+// entries already need them
+using FactoryCost = uint64_t;
+using FactoryDelta = int64_t;
+
+// Work done by bounded evaluations, terms are flow times distance products
+struct ScreeningCounters {
+    uint64_t evaluations = 0;
+    uint64_t rejected = 0;
+    uint64_t terms = 0;
+    uint64_t skippedTerms = 0;
+};
+
+// Kernels computing the cost of assigning locations to facilities
+struct FactoryKernels {
+    virtual ~FactoryKernels() = default;
+    virtual FactoryCost cost(const std::vector<uint>& locations) const = 0;
+    // Cost is a sum of non-negative terms, so evaluation stops after the row
+    // where partial cost exceeds threshold and that partial cost is returned
+    virtual FactoryCost boundedCost(const std::vector<uint>& locations, FactoryCost threshold, ScreeningCounters& counters) const = 0;
+    // Change of cost after swapping facilities on locations r and s, O(n)
+    virtual FactoryDelta swapDelta(const std::vector<uint>& locations, size_t r, size_t s) const = 0;
+    // Same, with positions of facilities (inverse of locations) kept by the
+    // caller, sparse kernels then visit only flows of the two facilities
+    virtual FactoryDelta indexedSwapDelta(const std::vector<uint>& locations, const std::vector<uint>&, size_t r, size_t s) const {
+        return swapDelta(locations, r, s);
+    }
+    // Memory held by the matrices
+    virtual size_t bytes() const = 0;
+};
+
+// Loaded instance, picks the narrowest matrix element type holding all values,
+// sparse flows when at most SPARSE_DENSITY of them are nonzero and otherwise
+// packed triangular distances when both matrices are symmetric. Symmetric
+// distances are packed next to sparse flows as well once full ones would take
+// more than PACKED_DISTANCE_BYTES.
+class FactoryInstance {
+public:
+    static constexpr double SPARSE_DENSITY = 0.1;
+    static constexpr size_t PACKED_DISTANCE_BYTES = size_t(64) << 20;
+
+    FactoryInstance(const Matrix<uint>& distanceMatrix, const Matrix<uint>& flowMatrix);
+
+    size_t size() const { return matrixSize; }
+    size_t elementSize() const { return bytesPerElement; }
+    bool isSymmetric() const { return symmetric; }
+    bool isSparse() const { return sparse; }
+    const FactoryKernels& kernels() const { return *factoryKernels; }
+    std::shared_ptr<const FactoryKernels> sharedKernels() const { return factoryKernels; }
+
+private:
+    size_t matrixSize;
+    size_t bytesPerElement;
+    bool symmetric;
+    bool sparse;
+    std::shared_ptr<const FactoryKernels> factoryKernels;
+};
+} // namespace FactoryProblem
+
+#endif // FACTORYINSTANCE_H
@@ -0,0 +1,321 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef FACTORYKERNELS_H
+#define FACTORYKERNELS_H
+#include "factoryinstance.h"
+#include "matrix.h"
+#include "scratcharena.h"
+
+namespace FactoryProblem {
+// General kernels, no assumption on symmetry of either matrix
+template <class Element>
+struct DenseFactoryKernels : public FactoryKernels {
+    DenseFactoryKernels(const Matrix<uint>& distanceMatrix, const Matrix<uint>& flowMatrix)
+        : distanceMatrix(distanceMatrix), flowMatrix(flowMatrix) {
+    }
+
+    const Matrix<Element> distanceMatrix;
+    const Matrix<Element> flowMatrix;
+
+    size_t bytes() const override { return distanceMatrix.bytes() + flowMatrix.bytes(); }
+
+    FactoryCost cost(const std::vector<uint>& locations) const override {
+        const size_t numberOfLocations = locations.size();
+
+        FactoryCost cost = 0;
+        for (size_t i = 0; i < numberOfLocations; i++) {
+            const Element* flowRow = flowMatrix[locations[i]];
+            const Element* distanceRow = distanceMatrix[i];
+
+            // Products are widened before summing, narrow elements would overflow
+            FactoryCost rowCost = 0;
+            for (size_t j = 0; j < numberOfLocations; j++) {
+                rowCost += static_cast<FactoryCost>(flowRow[locations[j]]) * distanceRow[j];
+            }
+            cost += rowCost;
+        }
+        return cost;
+    }
+
+    FactoryCost boundedCost(const std::vector<uint>& locations, FactoryCost threshold, ScreeningCounters& counters) const override {
+        const size_t numberOfLocations = locations.size();
+        counters.evaluations++;
+        counters.terms += numberOfLocations * numberOfLocations;
+
+        FactoryCost cost = 0;
+        for (size_t i = 0; i < numberOfLocations; i++) {
+            const Element* flowRow = flowMatrix[locations[i]];
+            const Element* distanceRow = distanceMatrix[i];
+
+            FactoryCost rowCost = 0;
+            for (size_t j = 0; j < numberOfLocations; j++) {
+                rowCost += static_cast<FactoryCost>(flowRow[locations[j]]) * distanceRow[j];
+            }
+            cost += rowCost;
+
+            if (cost > threshold) {
+                counters.rejected++;
+                counters.skippedTerms += (numberOfLocations - i - 1) * numberOfLocations;
+                break;
+            }
+        }
+        return cost;
+    }
+
+    FactoryDelta swapDelta(const std::vector<uint>& locations, size_t r, size_t s) const override {
+        const Element* flowR = flowMatrix[locations[r]];
+        const Element* flowS = flowMatrix[locations[s]];
+        const Element* distanceR = distanceMatrix[r];
+        const Element* distanceS = distanceMatrix[s];
+
+        auto d = [&](size_t i, size_t j) { return static_cast<FactoryDelta>(distanceMatrix.at(i, j)); };
+        auto f = [&](size_t i, size_t j) { return static_cast<FactoryDelta>(flowMatrix.at(locations[i], locations[j])); };
+
+        FactoryDelta delta = (d(r, r) - d(s, s)) * (f(s, s) - f(r, r))
+            + (d(r, s) - d(s, r)) * (f(s, r) - f(r, s));
+        for (size_t k = 0; k < locations.size(); k++) {
+            if (k == r || k == s)
+                continue;
+            const Element* flowK = flowMatrix[locations[k]];
+            delta += (d(k, r) - d(k, s))
+                    * (static_cast<FactoryDelta>(flowK[locations[s]]) - flowK[locations[r]])
+                + (static_cast<FactoryDelta>(distanceR[k]) - distanceS[k])
+                    * (static_cast<FactoryDelta>(flowS[locations[k]]) - flowR[locations[k]]);
+        }
+        return delta;
+    }
+};
+
+// Both matrices symmetric, only terms of the upper triangle are summed.
+// Distances are stored packed and walked along rows from the diagonal on.
+// Flows are read at permuted facilities, in a packed layout half of these
+// reads would go down columns across the whole triangle, so flows keep full
+// rows, which by symmetry are also their columns.
+template <class Element>
+struct SymmetricFactoryKernels : public FactoryKernels {
+    SymmetricFactoryKernels(const Matrix<uint>& distanceMatrix, const Matrix<uint>& flowMatrix)
+        : distanceMatrix(distanceMatrix), flowMatrix(flowMatrix),
+          zeroDiagonal(distanceMatrix.hasZeroDiagonal() || flowMatrix.hasZeroDiagonal()) {
+    }
+
+    const SymmetricMatrix<Element> distanceMatrix;
+    const Matrix<Element> flowMatrix;
+    const bool zeroDiagonal;
+
+    size_t bytes() const override { return distanceMatrix.bytes() + flowMatrix.bytes(); }
+
+    FactoryCost cost(const std::vector<uint>& locations) const override {
+        const size_t numberOfLocations = locations.size();
+
+        FactoryCost cost = 0;
+        FactoryCost diagonalCost = 0;
+        for (size_t i = 0; i < numberOfLocations; i++) {
+            const Element* flowRow = flowMatrix[locations[i]];
+            const Element* distanceRow = distanceMatrix.upper(i);
+
+            FactoryCost rowCost = 0;
+            for (size_t j = (i + 1); j < numberOfLocations; j++) {
+                rowCost += static_cast<FactoryCost>(flowRow[locations[j]]) * distanceRow[j];
+            }
+            cost += rowCost;
+
+            if (!zeroDiagonal)
+                diagonalCost += static_cast<FactoryCost>(flowRow[locations[i]]) * distanceRow[i];
+        }
+        return 2 * cost + diagonalCost;
+    }
+
+    FactoryCost boundedCost(const std::vector<uint>& locations, FactoryCost threshold, ScreeningCounters& counters) const override {
+        const size_t numberOfLocations = locations.size();
+        counters.evaluations++;
+        counters.terms += numberOfLocations * (numberOfLocations + 1) / 2;
+
+        // Doubled upper triangle and diagonal summed as they come
+        FactoryCost cost = 0;
+        for (size_t i = 0; i < numberOfLocations; i++) {
+            const Element* flowRow = flowMatrix[locations[i]];
+            const Element* distanceRow = distanceMatrix.upper(i);
+
+            FactoryCost rowCost = 0;
+            for (size_t j = (i + 1); j < numberOfLocations; j++) {
+                rowCost += static_cast<FactoryCost>(flowRow[locations[j]]) * distanceRow[j];
+            }
+            cost += 2 * rowCost;
+
+            if (!zeroDiagonal)
+                cost += static_cast<FactoryCost>(flowRow[locations[i]]) * distanceRow[i];
+
+            if (cost > threshold) {
+                const size_t remaining = numberOfLocations - i - 1;
+                counters.rejected++;
+                counters.skippedTerms += remaining * (remaining + 1) / 2;
+                break;
+            }
+        }
+        return cost;
+    }
+
+    // Distances to r and s come from their columns above the diagonal and
+    // from their rows below it, the three ranges are walked separately
+    FactoryDelta swapDelta(const std::vector<uint>& locations, size_t r, size_t s) const override {
+        if (r == s)
+            return 0;
+
+        const Element* flowR = flowMatrix[locations[r]];
+        const Element* flowS = flowMatrix[locations[s]];
+        const size_t low = std::min(r, s);
+        const size_t high = std::max(r, s);
+        const Element* distanceLow = distanceMatrix.upper(low);
+        const Element* distanceHigh = distanceMatrix.upper(high);
+        auto term = [&](size_t k, FactoryDelta distanceToLow, FactoryDelta distanceToHigh) {
+            return (distanceToLow - distanceToHigh)
+                * (static_cast<FactoryDelta>(flowS[locations[k]]) - flowR[locations[k]]);
+        };
+
+        FactoryDelta delta = 0;
+        for (size_t k = 0; k < low; k++) {
+            const Element* distanceK = distanceMatrix.upper(k);
+            delta += term(k, distanceK[low], distanceK[high]);
+        }
+        for (size_t k = (low + 1); k < high; k++) {
+            delta += term(k, distanceLow[k], distanceMatrix.upper(k)[high]);
+        }
+        for (size_t k = (high + 1); k < locations.size(); k++) {
+            delta += term(k, distanceLow[k], distanceHigh[k]);
+        }
+        // Terms were taken as low minus high, the swap moves r to s
+        delta *= (low == r) ? 2 : -2;
+
+        if (!zeroDiagonal) {
+            delta += (static_cast<FactoryDelta>(distanceMatrix.upper(r)[r]) - distanceMatrix.upper(s)[s])
+                * (static_cast<FactoryDelta>(flowS[locations[s]]) - flowR[locations[r]]);
+        }
+        return delta;
+    }
+};
+// Mostly zero flow matrix, only nonzero flows are visited. Flows are indexed
+// by facility, so terms are placed through positions of facilities. Distances
+// are read one by one, symmetric ones are stored packed.
+template <class Element, class DistanceMatrix = Matrix<Element>>
+struct SparseFactoryKernels : public FactoryKernels {
+    SparseFactoryKernels(const Matrix<uint>& distanceMatrix, const Matrix<uint>& flowMatrix)
+        : distanceMatrix(distanceMatrix), flowRows(flowMatrix),
+          symmetricFlow(flowMatrix.isSymmetric()),
+          flowColumns(symmetricFlow ? SparseMatrix<Element>(Matrix<uint>(0, 0)) : SparseMatrix<Element>(flowMatrix, true)) {
+    }
+
+    const DistanceMatrix distanceMatrix;
+    const SparseMatrix<Element> flowRows;
+    const bool symmetricFlow;
+    const SparseMatrix<Element> flowColumns; // Empty when columns are the rows
+
+    size_t bytes() const override { return distanceMatrix.bytes() + flowRows.bytes() + flowColumns.bytes(); }
+
+    FactoryCost cost(const std::vector<uint>& locations) const override {
+        const std::vector<uint>& positions = positionsOf(locations);
+
+        FactoryCost cost = 0;
+        for (size_t i = 0; i < locations.size(); i++) {
+            const uint facility = locations[i];
+
+            FactoryCost rowCost = 0;
+            for (size_t k = flowRows.rowBegin(facility); k < flowRows.rowEnd(facility); k++) {
+                rowCost += static_cast<FactoryCost>(flowRows.value(k)) * distanceMatrix.at(i, positions[flowRows.column(k)]);
+            }
+            cost += rowCost;
+        }
+        return cost;
+    }
+
+    FactoryCost boundedCost(const std::vector<uint>& locations, FactoryCost threshold, ScreeningCounters& counters) const override {
+        const std::vector<uint>& positions = positionsOf(locations);
+        counters.evaluations++;
+        counters.terms += flowRows.nonZeros();
+
+        FactoryCost cost = 0;
+        size_t visited = 0;
+        for (size_t i = 0; i < locations.size(); i++) {
+            const uint facility = locations[i];
+
+            FactoryCost rowCost = 0;
+            for (size_t k = flowRows.rowBegin(facility); k < flowRows.rowEnd(facility); k++) {
+                rowCost += static_cast<FactoryCost>(flowRows.value(k)) * distanceMatrix.at(i, positions[flowRows.column(k)]);
+            }
+            cost += rowCost;
+            visited += flowRows.rowEnd(facility) - flowRows.rowBegin(facility);
+
+            if (cost > threshold) {
+                counters.rejected++;
+                counters.skippedTerms += flowRows.nonZeros() - visited;
+                break;
+            }
+        }
+        return cost;
+    }
+
+    FactoryDelta swapDelta(const std::vector<uint>& locations, size_t r, size_t s) const override {
+        return indexedSwapDelta(locations, positionsOf(locations), r, s);
+    }
+
+    // Terms of rows of both facilities and of their columns outside these rows
+    FactoryDelta indexedSwapDelta(const std::vector<uint>& locations, const std::vector<uint>& positions, size_t r, size_t s) const override {
+        if (r == s)
+            return 0;
+
+        const uint u = locations[r];
+        const uint v = locations[s];
+        auto moved = [&](uint facility) -> size_t {
+            return facility == u ? s : facility == v ? r : positions[facility];
+        };
+        auto d = [&](size_t i, size_t j) { return static_cast<FactoryDelta>(distanceMatrix.at(i, j)); };
+
+        FactoryDelta delta = 0;
+        for (size_t k = flowRows.rowBegin(u); k < flowRows.rowEnd(u); k++) {
+            const uint b = flowRows.column(k);
+            delta += static_cast<FactoryDelta>(flowRows.value(k)) * (d(s, moved(b)) - d(r, positions[b]));
+        }
+        for (size_t k = flowRows.rowBegin(v); k < flowRows.rowEnd(v); k++) {
+            const uint b = flowRows.column(k);
+            delta += static_cast<FactoryDelta>(flowRows.value(k)) * (d(r, moved(b)) - d(s, positions[b]));
+        }
+
+        const SparseMatrix<Element>& columns = symmetricFlow ? flowRows : flowColumns;
+        for (size_t k = columns.rowBegin(u); k < columns.rowEnd(u); k++) {
+            const uint a = columns.column(k);
+            if (a != u && a != v)
+                delta += static_cast<FactoryDelta>(columns.value(k)) * (d(positions[a], s) - d(positions[a], r));
+        }
+        for (size_t k = columns.rowBegin(v); k < columns.rowEnd(v); k++) {
+            const uint a = columns.column(k);
+            if (a != u && a != v)
+                delta += static_cast<FactoryDelta>(columns.value(k)) * (d(positions[a], r) - d(positions[a], s));
+        }
+        return delta;
+    }
+
+private:
+    // Inverse of locations in a per thread buffer, slot is not used by operators
+    static const std::vector<uint>& positionsOf(const std::vector<uint>& locations) {
+        std::vector<uint>& positions = ScratchArena<uint>::local().buffer(ScratchArena<uint>::SLOTS - 1);
+        positions.resize(locations.size());
+        for (size_t i = 0; i < locations.size(); i++) {
+            positions[locations[i]] = static_cast<uint>(i);
+        }
+        return positions;
+    }
+};
+} // namespace FactoryProblem
+
+#endif // FACTORYKERNELS_H
@@ -13,7 +13,12 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "factoryproblem.h"
+#include "bulkrandom.h"
+#include "scratcharena.h"
 #include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
 
 //  Init function
 std::function<FactoryProblem::FactoryChromosome(void)>
@@ -28,141 +33,246 @@ FactoryProblem::getFactoryRandomInitializationFunction(
         std::shuffle(std::begin(fenotype.locations), std::end(fenotype.locations),
             RandomService::getService().getEngine());
 
-        return FactoryChromosome(fenotype, 0U);
+        return FactoryChromosome(fenotype, 0);
+    };
+}
+
+std::function<void(FactoryProblem::FactoryChromosome&)>
+FactoryProblem::getFactoryRandomReinitializationFunction() {
+    return [](FactoryChromosome& chromosome) {
+        std::vector<uint>& locations = chromosome.fenotype.locations;
+        std::iota(std::begin(locations), std::end(locations), 0U);
+        std::shuffle(std::begin(locations), std::end(locations), RandomService::getService().getEngine());
+        chromosome.lastEvaluation = 0;
+    };
+}
+
+std::function<FactoryProblem::FactoryChromosome(void)>
+FactoryProblem::getFactorySeededInitializationFunction(size_t numberOfLocations,
+    const std::vector<std::vector<uint>>& seeds, size_t seededCount) {
+    // Seeds of other sizes belong to another instance
+    std::vector<std::vector<uint>> usable;
+    std::copy_if(std::begin(seeds), std::end(seeds), std::back_inserter(usable),
+        [numberOfLocations](const std::vector<uint>& seed) { return seed.size() == numberOfLocations; });
+
+    auto randomFunction = getFactoryRandomInitializationFunction(numberOfLocations);
+    return [numberOfLocations, usable, seededCount, randomFunction, created = size_t(0)]() mutable {
+        if (usable.empty() || seededCount <= created || numberOfLocations < 2)
+            return randomFunction();
+
+        const size_t round = created / usable.size();
+        FactoryFenotype fenotype(numberOfLocations);
+        fenotype.locations = usable[created % usable.size()];
+        created++;
+
+        BulkRandom& random = BulkRandom::local();
+        const uint32_t range = static_cast<uint32_t>(numberOfLocations);
+        const size_t swaps = std::min(round, numberOfLocations / 2);
+        for (size_t swap = 0; swap < swaps; swap++)
+            std::swap(fenotype.locations[random.nextBelow(range)], fenotype.locations[random.nextBelow(range)]);
+
+        return FactoryChromosome(std::move(fenotype), 0);
     };
 }
 
 //  Evaluation function
-std::function<uint(FactoryProblem::FactoryChromosome&)>
-FactoryProblem::getFactoryEvaluationFunction(
-    const Matrix& distanceMatrix, const Matrix& flowMatrix) {
-    return [&](FactoryChromosome& chromosome) {
-        const vector<uint> locations = chromosome.fenotype.locations;
-
-        chromosome.lastEvaluation = 10000U;
-        for (size_t i = 0; i < locations.size(); i++) {
-            const std::vector<uint> flowRow = flowMatrix[locations[i]];
-            const std::vector<uint> distanceRow = distanceMatrix[i];
-
-            for (size_t j = (i + 1); j < locations.size(); j++) {
-                chromosome.lastEvaluation
-                    -= 2 * (flowRow[locations[j]] * distanceRow[j]);
-            }
-        }
+std::function<FactoryProblem::FactoryEval(FactoryProblem::FactoryChromosome&)>
+FactoryProblem::getFactoryEvaluationFunction(const FactoryInstance& instance) {
+    return [kernels = instance.sharedKernels()](FactoryChromosome& chromosome) {
+        chromosome.lastEvaluation = factoryCostToFitness(kernels->cost(chromosome.fenotype.locations));
         return chromosome.lastEvaluation;
     };
 }
 
-uint FactoryProblem::factoryFitnessToResult(uint fitness) {
-    return 10000U - fitness;
+std::function<FactoryProblem::FactoryEval(const std::vector<uint>&)>
+FactoryProblem::getFactoryPermutationEvaluationFunction(const FactoryInstance& instance) {
+    return [kernels = instance.sharedKernels()](const std::vector<uint>& locations) {
+        return factoryCostToFitness(kernels->cost(locations));
+    };
+}
+
+std::function<std::optional<FactoryProblem::FactoryEval>(const std::vector<uint>&, FactoryProblem::FactoryEval)>
+FactoryProblem::getFactoryScreeningFunction(const FactoryInstance& instance, ScreeningCounters& counters) {
+    return [kernels = instance.sharedKernels(), &counters](const std::vector<uint>& locations, FactoryEval threshold)
+               -> std::optional<FactoryEval> {
+        // Fitness above threshold is cost below its negation, lowest
+        // threshold accepts everything and no cost beats non-negative one
+        if (threshold >= 0)
+            return std::nullopt;
+        const FactoryCost maxCost = threshold == std::numeric_limits<FactoryEval>::lowest()
+            ? std::numeric_limits<FactoryCost>::max()
+            : factoryFitnessToResult(threshold) - 1;
+        const FactoryCost cost = kernels->boundedCost(locations, maxCost, counters);
+        if (cost > maxCost)
+            return std::nullopt;
+        return factoryCostToFitness(cost);
+    };
 }
 
-//  Crossing
-std::tuple<FactoryProblem::FactoryChromosome, FactoryProblem::FactoryChromosome>
-FactoryProblem::factoryOXCrossingFunction(
-    const FactoryChromosome& parent1, const FactoryChromosome& parent2) {
-    size_t numberOfLocations = parent1.fenotype.numberOfLocations;
-
-    RandomService& service = RandomService::getService();
-    auto indexGen
-        = service.getRangeFunction<uint>(0, static_cast<uint>(numberOfLocations));
-
-    auto generateChild = [&]() -> FactoryChromosome {
-        uint indexL = indexGen();
-        uint indexR = indexGen();
-
-        if (indexL > indexR)
-            std::swap(indexL, indexR);
-
-        FactoryFenotype childFenotype(numberOfLocations);
-        childFenotype.locations.resize(numberOfLocations);
-
-        std::copy(std::cbegin(parent1.fenotype.locations) + indexL,
-            std::cbegin(parent1.fenotype.locations) + indexR,
-            std::begin(childFenotype.locations) + indexL);
-
-        vector<uint> unusedLocations;
-        std::copy_if(std::cbegin(parent2.fenotype.locations),
-            std::cend(parent2.fenotype.locations),
-            std::back_inserter(unusedLocations), [&](const uint location) {
-                return std::find(std::cbegin(parent1.fenotype.locations) + indexL,
-                           std::cbegin(parent1.fenotype.locations) + indexR, location)
-                    == std::cbegin(parent1.fenotype.locations) + indexR;
-            });
-
-        uint unusedLocationsIndex = 0L;
-        for (uint i = 0; i < indexL; i++, unusedLocationsIndex++) {
-            childFenotype.locations[i] = unusedLocations[unusedLocationsIndex];
+std::function<bool(FactoryProblem::FactoryChromosome&, FactoryProblem::FactoryEval)>
+FactoryProblem::getFactoryOffspringScreeningFunction(const FactoryInstance& instance, ScreeningCounters& counters) {
+    return [kernels = instance.sharedKernels(), &counters](FactoryChromosome& chromosome, FactoryEval threshold) {
+        // Fitness at least threshold is cost at most its negation
+        if (threshold > 0)
+            return false;
+        const FactoryCost maxCost = threshold == std::numeric_limits<FactoryEval>::lowest()
+            ? std::numeric_limits<FactoryCost>::max()
+            : factoryFitnessToResult(threshold);
+        const FactoryCost cost = kernels->boundedCost(chromosome.fenotype.locations, maxCost, counters);
+        if (cost > maxCost)
+            return false;
+        chromosome.lastEvaluation = factoryCostToFitness(cost);
+        return true;
+    };
+}
+
+FactoryProblem::FactoryEval FactoryProblem::factoryCostToFitness(FactoryCost cost) {
+    return -static_cast<FactoryEval>(cost);
+}
+
+FactoryProblem::FactoryCost FactoryProblem::factoryFitnessToResult(FactoryEval fitness) {
+    return static_cast<FactoryCost>(-fitness);
+}
+
+//  Diversity
+std::function<void(const std::vector<FactoryProblem::FactoryChromosome>&, PopulationStatistics<FactoryProblem::FactoryEval>&)>
+FactoryProblem::getFactoryDiversityFunction(size_t numberOfLocations) {
+    // Buffers are kept between generations
+    std::vector<uint> counts(numberOfLocations * numberOfLocations);
+    std::vector<uint64_t> hashes;
+
+    return [numberOfLocations, counts, hashes](const std::vector<FactoryChromosome>& population,
+               PopulationStatistics<FactoryEval>& statistics) mutable {
+        if (population.empty() || numberOfLocations < 2)
+            return;
+
+        std::fill(std::begin(counts), std::end(counts), 0U);
+        hashes.clear();
+        for (const auto& chromosome : population) {
+            // FNV-1a over the permutation
+            uint64_t hash = 14695981039346656037ULL;
+            const vector<uint>& locations = chromosome.fenotype.locations;
+            for (size_t position = 0; position < numberOfLocations; position++) {
+                counts[position * numberOfLocations + locations[position]]++;
+                hash = (hash ^ locations[position]) * 1099511628211ULL;
+            }
+            hashes.push_back(hash);
         }
 
-        for (uint i = indexR; i < numberOfLocations; i++, unusedLocationsIndex++) {
-            childFenotype.locations[i] = unusedLocations[unusedLocationsIndex];
+        const double populationSize = static_cast<double>(population.size());
+        double entropy = 0.0;
+        for (const uint count : counts) {
+            if (count != 0) {
+                const double share = count / populationSize;
+                entropy -= share * std::log(share);
+            }
         }
+        statistics.positionalEntropy = entropy / (numberOfLocations * std::log(static_cast<double>(numberOfLocations)));
 
-        return FactoryChromosome(childFenotype, 0U);
+        std::sort(std::begin(hashes), std::end(hashes));
+        const auto unique = std::unique(std::begin(hashes), std::end(hashes)) - std::begin(hashes);
+        statistics.uniqueFraction = unique / populationSize;
     };
-
-    return std::make_tuple(generateChild(), generateChild());
 }
 
-std::tuple<FactoryProblem::FactoryChromosome, FactoryProblem::FactoryChromosome>
-FactoryProblem::factorySymetricOXCrossingFunction(
-    const FactoryChromosome& parent1, const FactoryChromosome& parent2) {
-    size_t numberOfLocations = parent1.fenotype.numberOfLocations;
+//  Crossing
+namespace {
+// Copies [indexL, indexR) from parentA and fills the rest in order of parentB
+void fillOXChild(const FactoryProblem::FactoryChromosome& parentA,
+    const FactoryProblem::FactoryChromosome& parentB,
+    uint indexL, uint indexR, FactoryProblem::FactoryChromosome& child) {
+    const size_t numberOfLocations = parentA.fenotype.numberOfLocations;
+    const vector<uint>& locationsA = parentA.fenotype.locations;
+
+    // Resizing a recycled child keeps its storage
+    child.fenotype.numberOfLocations = numberOfLocations;
+    child.fenotype.locations.resize(numberOfLocations);
+    child.lastEvaluation = 0;
+
+    std::copy(std::cbegin(locationsA) + indexL, std::cbegin(locationsA) + indexR,
+        std::begin(child.fenotype.locations) + indexL);
+
+    vector<uint>& unusedLocations = ScratchArena<uint>::local().buffer(0);
+    std::copy_if(std::cbegin(parentB.fenotype.locations),
+        std::cend(parentB.fenotype.locations),
+        std::back_inserter(unusedLocations), [&](const uint location) {
+            return std::find(std::cbegin(locationsA) + indexL,
+                       std::cbegin(locationsA) + indexR, location)
+                == std::cbegin(locationsA) + indexR;
+        });
+
+    uint unusedLocationsIndex = 0L;
+    for (uint i = 0; i < indexL; i++, unusedLocationsIndex++) {
+        child.fenotype.locations[i] = unusedLocations[unusedLocationsIndex];
+    }
+
+    for (uint i = indexR; i < numberOfLocations; i++, unusedLocationsIndex++) {
+        child.fenotype.locations[i] = unusedLocations[unusedLocationsIndex];
+    }
+}
 
-    RandomService& service = RandomService::getService();
-    auto indexGen = service.getRangeFunction<uint>(0, static_cast<uint>(numberOfLocations));
+std::tuple<uint, uint> pickOXSegment(size_t numberOfLocations) {
+    BulkRandom& random = BulkRandom::local();
 
-    uint indexL = indexGen();
-    uint indexR = indexGen();
+    uint indexL = random.nextBelow(static_cast<uint>(numberOfLocations));
+    uint indexR = random.nextBelow(static_cast<uint>(numberOfLocations));
 
     if (indexL > indexR)
         std::swap(indexL, indexR);
 
-    FactoryFenotype child1Fenotype(numberOfLocations);
-    child1Fenotype.locations.resize(numberOfLocations);
-
-    FactoryFenotype child2Fenotype(numberOfLocations);
-    child2Fenotype.locations.resize(numberOfLocations);
-
-    auto generateFenotype = [&](const FactoryChromosome& parentA, const FactoryChromosome& parentB, FactoryFenotype& fenotype) {
-        std::copy(std::cbegin(parentA.fenotype.locations) + indexL,
-            std::cbegin(parentA.fenotype.locations) + indexR,
-            std::begin(fenotype.locations) + indexL);
-
-        vector<uint> unusedLocations;
-        std::copy_if(std::cbegin(parentB.fenotype.locations),
-            std::cend(parentB.fenotype.locations),
-            std::back_inserter(unusedLocations), [&](const uint location) {
-                return std::find(std::cbegin(parentA.fenotype.locations) + indexL,
-                           std::cbegin(parentA.fenotype.locations) + indexR, location)
-                    == std::cbegin(parentA.fenotype.locations) + indexR;
-            });
-
-        uint unusedLocationsIndex = 0L;
-        for (uint i = 0; i < indexL; i++, unusedLocationsIndex++) {
-            fenotype.locations[i] = unusedLocations[unusedLocationsIndex];
-        }
+    return std::make_tuple(indexL, indexR);
+}
+} // namespace
 
-        for (uint i = indexR; i < numberOfLocations; i++, unusedLocationsIndex++) {
-            fenotype.locations[i] = unusedLocations[unusedLocationsIndex];
-        }
-    };
+void FactoryProblem::factoryInPlaceOXCrossingFunction(
+    const FactoryChromosome& parent1, const FactoryChromosome& parent2,
+    FactoryChromosome& child1, FactoryChromosome& child2) {
+    const size_t numberOfLocations = parent1.fenotype.numberOfLocations;
 
-    generateFenotype(parent1, parent2, child1Fenotype);
-    generateFenotype(parent2, parent1, child2Fenotype);
+    // Every child gets its own segment
+    uint indexL, indexR;
+    std::tie(indexL, indexR) = pickOXSegment(numberOfLocations);
+    fillOXChild(parent1, parent2, indexL, indexR, child1);
 
-    return std::make_tuple(FactoryChromosome(child1Fenotype, 0U), FactoryChromosome(child2Fenotype, 0));
+    std::tie(indexL, indexR) = pickOXSegment(numberOfLocations);
+    fillOXChild(parent1, parent2, indexL, indexR, child2);
+}
+
+void FactoryProblem::factoryInPlaceSymetricOXCrossingFunction(
+    const FactoryChromosome& parent1, const FactoryChromosome& parent2,
+    FactoryChromosome& child1, FactoryChromosome& child2) {
+    uint indexL, indexR;
+    std::tie(indexL, indexR) = pickOXSegment(parent1.fenotype.numberOfLocations);
+
+    fillOXChild(parent1, parent2, indexL, indexR, child1);
+    fillOXChild(parent2, parent1, indexL, indexR, child2);
+}
+
+std::tuple<FactoryProblem::FactoryChromosome, FactoryProblem::FactoryChromosome>
+FactoryProblem::factoryOXCrossingFunction(
+    const FactoryChromosome& parent1, const FactoryChromosome& parent2) {
+    FactoryChromosome child1 = parent1;
+    FactoryChromosome child2 = parent2;
+    factoryInPlaceOXCrossingFunction(parent1, parent2, child1, child2);
+    return std::make_tuple(std::move(child1), std::move(child2));
+}
+
+std::tuple<FactoryProblem::FactoryChromosome, FactoryProblem::FactoryChromosome>
+FactoryProblem::factorySymetricOXCrossingFunction(
+    const FactoryChromosome& parent1, const FactoryChromosome& parent2) {
+    FactoryChromosome child1 = parent1;
+    FactoryChromosome child2 = parent2;
+    factoryInPlaceSymetricOXCrossingFunction(parent1, parent2, child1, child2);
+    return std::make_tuple(std::move(child1), std::move(child2));
 }
 
 //  Mutating
 void FactoryProblem::factorySwapMuatationFunction(FactoryChromosome& object) {
-    RandomService& service = RandomService::getService();
-    auto indexGen
-        = service.getRangeFunction<size_t>(0, object.fenotype.numberOfLocations);
+    BulkRandom& random = BulkRandom::local();
+    const uint numberOfLocations = static_cast<uint>(object.fenotype.numberOfLocations);
 
-    uint indexA = static_cast<uint>(indexGen());
-    uint indexB = static_cast<uint>(indexGen());
+    uint indexA = random.nextBelow(numberOfLocations);
+    uint indexB = random.nextBelow(numberOfLocations);
 
     std::iter_swap(std::begin(object.fenotype.locations) + indexA,
         std::begin(object.fenotype.locations) + indexB);
@@ -14,12 +14,14 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef FACTORYPROBLEM_H
 #define FACTORYPROBLEM_H
+#include "factoryinstance.h"
 #include "geneticalgorithm.h"
 #include "matrix.h"
 #include "randomservice.h"
 #include <algorithm>
 #include <array>
 #include <functional>
+#include <optional>
 #include <tuple>
 #include <vector>
 
@@ -33,19 +35,43 @@ struct FactoryFenotype {
     size_t numberOfLocations;
 };
 
-using FactoryChromosome = Chromosome<FactoryFenotype, uint>;
+// Fitness is the negated cost, so it grows with quality and never wraps for
+// costs up to INT64_MAX
+using FactoryEval = int64_t;
+using FactoryChromosome = Chromosome<FactoryFenotype, FactoryEval>;
 
 // Initialization
 std::function<FactoryChromosome(void)> getFactoryRandomInitializationFunction(size_t numberOfLocations);
+// First seededCount chromosomes are copies of seeds, exact in the first round
+// and with more random swaps in every next one, the rest are random
+std::function<FactoryChromosome(void)> getFactorySeededInitializationFunction(size_t numberOfLocations,
+    const std::vector<std::vector<uint>>& seeds, size_t seededCount);
+// Random permutation written over an existing chromosome, storage is reused
+std::function<void(FactoryChromosome&)> getFactoryRandomReinitializationFunction();
 
 // Evaluation
-std::function<uint(FactoryChromosome&)> getFactoryEvaluationFunction(const Matrix& distanceMatrix, const Matrix& flowMatrix);
-uint factoryFitnessToResult(uint fitness);
+std::function<FactoryEval(FactoryChromosome&)> getFactoryEvaluationFunction(const FactoryInstance& instance);
+std::function<FactoryEval(const std::vector<uint>&)> getFactoryPermutationEvaluationFunction(const FactoryInstance& instance);
+// Screening, fitness is returned only when it exceeds threshold, counters
+// must outlive the returned function
+std::function<std::optional<FactoryEval>(const std::vector<uint>&, FactoryEval)> getFactoryScreeningFunction(const FactoryInstance& instance, ScreeningCounters& counters);
+// Screening of offspring, chromosome is evaluated and kept when its fitness
+// is at least threshold, counters must outlive the returned function
+std::function<bool(FactoryChromosome&, FactoryEval)> getFactoryOffspringScreeningFunction(const FactoryInstance& instance, ScreeningCounters& counters);
+FactoryEval factoryCostToFitness(FactoryCost cost);
+FactoryCost factoryFitnessToResult(FactoryEval fitness);
+
+// Diversity, positional entropy and fraction of unique permutations
+std::function<void(const std::vector<FactoryChromosome>&, PopulationStatistics<FactoryEval>&)> getFactoryDiversityFunction(size_t numberOfLocations);
 
 // Crossings
 std::tuple<FactoryChromosome, FactoryChromosome> factoryOXCrossingFunction(const FactoryChromosome& parent1, const FactoryChromosome& parent2);
 std::tuple<FactoryChromosome, FactoryChromosome> factorySymetricOXCrossingFunction(const FactoryChromosome& parent1, const FactoryChromosome& parent2);
 
+// Crossings writing children into given chromosomes, storage is reused
+void factoryInPlaceOXCrossingFunction(const FactoryChromosome& parent1, const FactoryChromosome& parent2, FactoryChromosome& child1, FactoryChromosome& child2);
+void factoryInPlaceSymetricOXCrossingFunction(const FactoryChromosome& parent1, const FactoryChromosome& parent2, FactoryChromosome& child1, FactoryChromosome& child2);
+
 // Muatation
 void factorySwapMuatationFunction(FactoryChromosome& object);
 } // namespace FactoryProblem
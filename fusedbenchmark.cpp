@@ -0,0 +1,73 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "fusedbenchmark.h"
+#include "generics.h"
+#include <chrono>
+
+namespace {
+struct Measurement {
+    double secondsPerGeneration = 0.0;
+    double meanResult = 0.0;
+};
+
+Measurement measure(const FactoryProblem::FactoryInstance& instance,
+    const FactoryProblem::GeneticConfiguration& configuration,
+    size_t generations, size_t repetitions) {
+    using Fenotype = FactoryProblem::FactoryFenotype;
+    using Eval = FactoryProblem::FactoryEval;
+
+    Measurement measurement;
+    for (size_t repetition = 0; repetition < repetitions; repetition++) {
+        GenericIterationCountStopCondition<Fenotype, Eval> stopCondition(generations);
+        GenericNoLoggingFunction<Fenotype, Eval> loggingFunction;
+
+        const auto start = std::chrono::steady_clock::now();
+        const FactoryProblem::FactoryChromosome found = FactoryProblem::runGeneticAlgorithm(instance, configuration, stopCondition, loggingFunction);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        measurement.secondsPerGeneration += elapsed.count() / generations;
+        measurement.meanResult += FactoryProblem::factoryFitnessToResult(found.lastEvaluation);
+    }
+    measurement.secondsPerGeneration /= repetitions;
+    measurement.meanResult /= repetitions;
+    return measurement;
+}
+} // namespace
+
+void FusedBenchmark::run(std::ostream& os, const Qaplib::QaplibInstance& read,
+    FactoryProblem::GeneticConfiguration configuration,
+    const std::vector<size_t>& populationSizes, size_t generations, size_t repetitions) {
+    os << "populationSize,genomeBytes,stagedSecondsPerGeneration,fusedSecondsPerGeneration,speedup,stagedMeanResult,fusedMeanResult\n";
+
+    const FactoryProblem::FactoryInstance instance(read.distanceMatrix, read.flowMatrix);
+    generations = std::max<size_t>(1, generations);
+    repetitions = std::max<size_t>(1, repetitions);
+
+    for (const size_t populationSize : populationSizes) {
+        configuration.populationSize = populationSize;
+
+        configuration.fused = false;
+        const Measurement staged = measure(instance, configuration, generations, repetitions);
+        configuration.fused = true;
+        const Measurement fused = measure(instance, configuration, generations, repetitions);
+
+        // Bytes of genes of one generation, each staged pass streams them again
+        const size_t genomeBytes = populationSize * instance.size() * sizeof(uint);
+        os << populationSize << "," << genomeBytes << ","
+           << staged.secondsPerGeneration << "," << fused.secondsPerGeneration << ","
+           << staged.secondsPerGeneration / fused.secondsPerGeneration << ","
+           << staged.meanResult << "," << fused.meanResult << std::endl;
+    }
+}
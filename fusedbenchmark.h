@@ -0,0 +1,31 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef FUSEDBENCHMARK_H
+#define FUSEDBENCHMARK_H
+#include "factorygenetic.h"
+#include "qaplib.h"
+#include <iostream>
+#include <vector>
+
+// Staged against fused generation pipeline with the same operators, one CSV row
+// per population size. Results of both should agree, times differ once the
+// population does not fit in cache.
+namespace FusedBenchmark {
+void run(std::ostream& os, const Qaplib::QaplibInstance& instance,
+    FactoryProblem::GeneticConfiguration configuration,
+    const std::vector<size_t>& populationSizes, size_t generations, size_t repetitions);
+}
+
+#endif // FUSEDBENCHMARK_H
@@ -14,9 +14,11 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef GENERICS_H
 #define GENERICS_H
+#include "bulkrandom.h"
 #include "geneticalgorithm.h"
 #include "randomservice.h"
 #include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <tuple>
@@ -50,17 +52,43 @@ template <class Fenotype, class Eval>
 struct GenericEvaluationFunction : public EvaluationFunction<Fenotype, Eval> {
     using Population = std::vector<Chromosome<Fenotype, Eval>>;
 
+    using Statistics = PopulationStatistics<Eval>;
+
     GenericEvaluationFunction(
-        std::function<Eval(Chromosome<Fenotype, Eval>&)> evalFunction)
-        : evalFunction(evalFunction) {
+        std::function<Eval(Chromosome<Fenotype, Eval>&)> evalFunction,
+        std::function<void(const Population&, Statistics&)> diversityFunction = nullptr,
+        std::function<bool(Chromosome<Fenotype, Eval>&, Eval)> screenFunction = nullptr)
+        : evalFunction(evalFunction), diversityFunction(diversityFunction), screenFunction(screenFunction) {
     }
     const std::function<Eval(Chromosome<Fenotype, Eval>&)> evalFunction;
+    const std::function<void(const Population&, Statistics&)> diversityFunction;
+    // Bounded evaluation, full one is used when not given
+    const std::function<bool(Chromosome<Fenotype, Eval>&, Eval)> screenFunction;
+
+    Statistics operator()(Population& population) const override {
+        // Evaluate and gather statistics in one pass
+        StatisticsAccumulator<Eval> accumulator;
+        for (auto& chromosome : population)
+            accumulator.add(evalFunction(chromosome));
+
+        Statistics statistics = accumulator.finish();
+        complete(population, statistics);
+        return statistics;
+    }
 
-    Eval operator()(Population& population) const override {
-        std::vector<Eval> scores;
-        std::transform(std::begin(population), std::end(population),
-            std::back_inserter(scores), evalFunction);
-        return std::accumulate(std::cbegin(scores), std::cend(scores), Eval());
+    Eval evaluate(Chromosome<Fenotype, Eval>& chromosome) const override {
+        return evalFunction(chromosome);
+    }
+
+    void complete(const Population& population, Statistics& statistics) const override {
+        if (diversityFunction && !population.empty())
+            diversityFunction(population, statistics);
+    }
+
+    bool screen(Chromosome<Fenotype, Eval>& chromosome, Eval threshold) const override {
+        if (!screenFunction)
+            return EvaluationFunction<Fenotype, Eval>::screen(chromosome, threshold);
+        return screenFunction(chromosome, threshold);
     }
 };
 
@@ -76,11 +104,36 @@ struct GenericIterationCountStopCondition
     size_t currentIteration = 0;
     const size_t maxIterations;
 
-    bool operator()(const Population&, const Eval&) override {
+    bool operator()(const Population&, const PopulationStatistics<Eval>&) override {
         return currentIteration++ >= maxIterations;
     }
 };
 
+template <class Fenotype, class Eval>
+struct GenericCallbackStopCondition
+    : public StopCondition<Fenotype, Eval> {
+    using Population = std::vector<Chromosome<Fenotype, Eval>>;
+
+    // Callback gets population and statistics of every generation and returns true to stop
+    GenericCallbackStopCondition(std::function<bool(const Population&, const PopulationStatistics<Eval>&)> callback)
+        : callback(callback) {
+    }
+
+    std::function<bool(const Population&, const PopulationStatistics<Eval>&)> callback;
+
+    bool operator()(const Population& population, const PopulationStatistics<Eval>& statistics) override {
+        return callback(population, statistics);
+    }
+};
+
+template <class Fenotype, class Eval>
+struct GenericNoLoggingFunction : public LoggingFunction<Fenotype, Eval> {
+    using Population = std::vector<Chromosome<Fenotype, Eval>>;
+
+    void operator()(const Population&, const PopulationStatistics<Eval>&) override {}
+    void show() const override {}
+};
+
 template <class Fenotype, class Eval>
 struct GenericConsoleLoggingFunction : public LoggingFunction<Fenotype, Eval> {
     using Population = std::vector<Chromosome<Fenotype, Eval>>;
@@ -92,32 +145,19 @@ struct GenericConsoleLoggingFunction : public LoggingFunction<Fenotype, Eval> {
 
     std::function<long(Eval)> fitnessToResult;
 
-    void operator()(const Population& population) override {
+    void operator()(const Population& population, const PopulationStatistics<Eval>& statistics) override {
         std::cout << "-------------------------------------------\n";
         std::cout << "Iteration: " << currentIteration << "\n";
         std::cout << "Population size: " << population.size() << "\n";
-        std::cout << "Max value: "
-                  << fitnessToResult((*std::max_element(std::cbegin(population),
-                                          std::cend(population)))
-                                         .lastEvaluation)
-                  << "\n";
-        std::cout << "Mean value: "
-                  << fitnessToResult(std::accumulate(
-                         std::cbegin(population), std::cend(population), Eval(),
-                         [](Eval accumulator,
-                             const Chromosome<Fenotype, Eval> chromosome) {
-                             return accumulator += chromosome.lastEvaluation;
-                         }))
-                / static_cast<Eval>(population.size())
-                  << "\n";
-        std::cout << "Min value: "
-                  << fitnessToResult((*std::min_element(std::cbegin(population),
-                                          std::cend(population)))
-                                         .lastEvaluation)
-                  << std::endl;
+        std::cout << "Max value: " << fitnessToResult(statistics.max) << "\n";
+        std::cout << "Mean value: " << fitnessToResult(static_cast<Eval>(statistics.mean)) << "\n";
+        std::cout << "Min value: " << fitnessToResult(statistics.min) << "\n";
+        std::cout << "Standard deviation: " << std::sqrt(statistics.variance) << "\n";
+        std::cout << "Positional entropy: " << statistics.positionalEntropy << "\n";
+        std::cout << "Unique fraction: " << statistics.uniqueFraction << std::endl;
         currentIteration++;
     }
-    void show() override {}
+    void show() const override {}
 };
 
 template <class Fenotype, class Eval>
@@ -127,26 +167,20 @@ struct GenericJSLoggingFunction : public LoggingFunction<Fenotype, Eval> {
     std::vector<Eval> avg;
     std::vector<Eval> max;
 
-    GenericJSLoggingFunction(std::function<long(Eval)> fitnessToResult)
+    // Expected iterations are reserved up front, so logging does not allocate
+    GenericJSLoggingFunction(std::function<long(Eval)> fitnessToResult, size_t expectedIterations = 0)
         : fitnessToResult(fitnessToResult) {
+        min.reserve(expectedIterations);
+        avg.reserve(expectedIterations);
+        max.reserve(expectedIterations);
     }
 
     std::function<long(Eval)> fitnessToResult;
 
-    void operator()(const Population& population) override {
-        max.push_back(
-            (*std::max_element(std::cbegin(population), std::cend(population)))
-                .lastEvaluation);
-        avg.push_back(
-            std::accumulate(
-                std::cbegin(population), std::cend(population), Eval(),
-                [](Eval accumulator, const Chromosome<Fenotype, Eval> chromosome) {
-                    return accumulator += chromosome.lastEvaluation;
-                })
-            / static_cast<Eval>(population.size()));
-        min.push_back(
-            (*std::min_element(std::cbegin(population), std::cend(population)))
-                .lastEvaluation);
+    void operator()(const Population&, const PopulationStatistics<Eval>& statistics) override {
+        max.push_back(statistics.max);
+        avg.push_back(static_cast<Eval>(statistics.mean));
+        min.push_back(statistics.min);
     }
 
     void show() const override {
@@ -225,44 +259,137 @@ struct GenericJSLoggingFunction : public LoggingFunction<Fenotype, Eval> {
     }
 };
 
+// Population size functions
+template <class Fenotype, class Eval>
+struct GenericAdaptivePopulationSizeFunction
+    : public PopulationSizeFunction<Fenotype, Eval> {
+    using Population = std::vector<Chromosome<Fenotype, Eval>>;
+    using Statistics = PopulationStatistics<Eval>;
+
+    // Shrinks the population while the best chromosome improves. When the best
+    // stagnates or distinct chromosomes collapse below the threshold part of the
+    // population is replaced with new chromosomes, and when the previous reseed
+    // did not lead to a better chromosome the population doubles as well.
+    // Collapse is only detected when evaluation fills uniqueFraction.
+    // Replaced chromosomes are reinitialized in place.
+    GenericAdaptivePopulationSizeFunction(
+        size_t minPopulationSize, size_t maxPopulationSize,
+        std::function<void(Chromosome<Fenotype, Eval>&)> reinitFunction,
+        size_t stagnationLimit = 20, size_t reseedCooldown = 5, double collapseThreshold = 0.2,
+        double shrinkFactor = 0.95, double reseedFraction = 0.5)
+        : minPopulationSize(std::max<size_t>(2, minPopulationSize))
+        , maxPopulationSize(std::max(this->minPopulationSize, maxPopulationSize))
+        , reinitFunction(reinitFunction)
+        , stagnationLimit(stagnationLimit)
+        , reseedCooldown(reseedCooldown)
+        , collapseThreshold(collapseThreshold)
+        , shrinkFactor(shrinkFactor)
+        , reseedFraction(reseedFraction) {
+    }
+
+    const size_t minPopulationSize;
+    const size_t maxPopulationSize;
+    std::function<void(Chromosome<Fenotype, Eval>&)> reinitFunction;
+    const size_t stagnationLimit;
+    const size_t reseedCooldown;
+    const double collapseThreshold;
+    const double shrinkFactor;
+    const double reseedFraction;
+
+    bool evaluated = false;
+    Eval best = Eval();
+    size_t stagnation = 0;
+    size_t sinceReseed = 0;
+    bool improvedSinceReseed = true;
+    bool reseeding = false;
+    size_t reseeds = 0;
+
+    size_t operator()(const Population& population, const Statistics& statistics) override {
+        const size_t populationSize = population.size();
+        const bool improved = !evaluated || best < statistics.max;
+        if (improved) {
+            best = statistics.max;
+            evaluated = true;
+            stagnation = 0;
+            improvedSinceReseed = true;
+        } else {
+            stagnation++;
+        }
+        sinceReseed++;
+
+        reseeding = reseedCooldown <= sinceReseed
+            && (stagnationLimit <= stagnation || statistics.uniqueFraction < collapseThreshold);
+        if (reseeding) {
+            // Reseeding at this size did not help last time, a bigger population is needed
+            const size_t reseededSize = improvedSinceReseed ? populationSize : 2 * populationSize;
+            stagnation = 0;
+            sinceReseed = 0;
+            improvedSinceReseed = false;
+            return std::clamp(reseededSize, minPopulationSize, maxPopulationSize);
+        }
+
+        // Steady progress needs fewer evaluations
+        if (improved)
+            return std::clamp(static_cast<size_t>(populationSize * shrinkFactor), minPopulationSize, maxPopulationSize);
+        return std::clamp(populationSize, minPopulationSize, maxPopulationSize);
+    }
+
+    void reseed(Population& selected, const Population&, const Statistics&) override {
+        if (!reseeding)
+            return;
+        reseeds++;
+
+        // Tail of the selection is replaced, first slot is kept for the best
+        const size_t count = std::min(selected.size() - 1, static_cast<size_t>(selected.size() * reseedFraction));
+        for (size_t i = selected.size() - count; i < selected.size(); i++)
+            reinitFunction(selected[i]);
+    }
+
+    void restore(Population& varied, const Population& previous, const Statistics& statistics) override {
+        // Best chromosome survives the reseed, whatever crossing and mutation did to its slot
+        if (reseeding)
+            varied[0] = previous[statistics.bestIndex];
+    }
+};
+
 // Selection functions
 template <class Fenotype, class Eval>
 struct GenericTournamentSelectionFunction
     : public SelectionFunction<Fenotype, Eval> {
     using Population = std::vector<Chromosome<Fenotype, Eval>>;
-    GenericTournamentSelectionFunction(size_t tournamentSize,
-        size_t populationSize)
-        : tournamentSize(tournamentSize), populationSize(populationSize) {
+    // With referencePopulationSize the tournament is resized with the
+    // population, keeping the share of it that tournamentSize has at that size
+    GenericTournamentSelectionFunction(size_t tournamentSize, size_t referencePopulationSize = 0)
+        : tournamentSize(tournamentSize), referencePopulationSize(referencePopulationSize) {
     }
 
     size_t tournamentSize;
-    size_t populationSize;
+    size_t referencePopulationSize; // 0 for a fixed tournament
 
     // Random generator
-    RandomService& service = RandomService::getService();
-    std::function<size_t(void)> pickIndex = service.getRangeFunction<size_t>(0, populationSize);
-
-    Population operator()(const Population& population) const override {
-        Population newPopulation;
+    BulkRandom& random = BulkRandom::local();
 
-        // Generate
-        std::generate_n(std::back_inserter(newPopulation), populationSize, [&]() {
-            std::vector<const Chromosome<Fenotype, Eval>*> tournament;
-
-            // Generate new tournanemt
-            std::generate_n(std::back_inserter(tournament), tournamentSize,
-                [&]() { return &population[pickIndex()]; });
-
-            // And find best
-            return **std::max_element(std::cbegin(tournament), std::cend(tournament),
-                [](const Chromosome<Fenotype, Eval>* left,
-                    const Chromosome<Fenotype, Eval>* right) {
-                    return *left < *right;
-                });
-        });
+    // Sizes of both populations are taken from the vectors, they may change between generations
+    void operator()(const Population& population, Population& newPopulation) const override {
+        for (auto& chromosome : newPopulation) {
+            // Copy assignment reuses genes storage of the old chromosome
+            chromosome = pick(population);
+        }
+    }
 
-        // Move new population in place of old one
-        return newPopulation;
+    const Chromosome<Fenotype, Eval>& pick(const Population& population) const override {
+        // Tournament is kept as a running best, no buffer of contestants
+        const uint32_t range = static_cast<uint32_t>(population.size());
+        const size_t contestants = referencePopulationSize == 0
+            ? tournamentSize
+            : std::max<size_t>(2, tournamentSize * population.size() / referencePopulationSize);
+        const Chromosome<Fenotype, Eval>* best = &population[random.nextBelow(range)];
+        for (size_t i = 1; i < contestants; i++) {
+            const Chromosome<Fenotype, Eval>* contestant = &population[random.nextBelow(range)];
+            if (*best < *contestant)
+                best = contestant;
+        }
+        return *best;
     }
 };
 
@@ -271,32 +398,59 @@ struct GenericCrossoverFunction : public CrossoverFunction<Fenotype, Eval> {
     using Population = std::vector<Chromosome<Fenotype, Eval>>;
     using TypedChromosome = Chromosome<Fenotype, Eval>;
 
+    using CrossingFunction = std::function<std::tuple<TypedChromosome, TypedChromosome>(
+        TypedChromosome, TypedChromosome)>;
+    // Reads parents and writes children into given chromosomes
+    using InPlaceCrossingFunction = std::function<void(const TypedChromosome&,
+        const TypedChromosome&, TypedChromosome&, TypedChromosome&)>;
+
     GenericCrossoverFunction(
         double crossoverProbability,
-        std::function<std::tuple<TypedChromosome, TypedChromosome>(
-            TypedChromosome, TypedChromosome)>
-            crossingFunction)
+        CrossingFunction crossingFunction)
         : crossoverProbability(crossoverProbability), crossingFunction(crossingFunction) {
     }
 
+    GenericCrossoverFunction(
+        double crossoverProbability,
+        InPlaceCrossingFunction inPlaceCrossingFunction)
+        : crossoverProbability(crossoverProbability), inPlaceCrossingFunction(inPlaceCrossingFunction) {
+    }
+
     double crossoverProbability;
-    std::function<std::tuple<TypedChromosome, TypedChromosome>(TypedChromosome,
-        TypedChromosome)>
-        crossingFunction;
+    CrossingFunction crossingFunction;
+    InPlaceCrossingFunction inPlaceCrossingFunction;
+
+    // Children of in place crossing, swapped with parents after crossing
+    mutable Population children;
 
     // Random generator
-    RandomService& service = RandomService::getService();
-    std::function<bool(void)> isCrossing = service.getBoolFunction(crossoverProbability);
+    BulkRandom& random = BulkRandom::local();
+    GeometricSkip crossingSkip{ crossoverProbability };
+
+    // Pairs left until the next crossing of the fused pipeline
+    mutable size_t pairsToCrossing = crossingSkip.first(random);
 
     void operator()(Population& population) const override {
-        // Shuffle
-        std::shuffle(std::begin(population), std::end(population),
-            service.getEngine());
-
-        // For every pair
-        for (size_t i = 0; i < population.size() / 2; i++) {
-            // Check if it is crossing
-            if (isCrossing()) {
+        // Shuffle (Fisher-Yates)
+        for (size_t i = population.size(); i > 1; i--) {
+            std::swap(population[i - 1], population[random.nextBelow(static_cast<uint32_t>(i))]);
+        }
+
+        // Jump straight to crossing pairs, pairs are disjoint, odd last chromosome stays
+        const size_t pairs = population.size() / 2;
+        for (size_t pair = crossingSkip.first(random); pair < pairs; pair = crossingSkip.next(pair, random)) {
+            const size_t i = 2 * pair;
+
+            if (inPlaceCrossingFunction) {
+                // First crossing sizes children, later ones reuse their storage
+                if (children.empty()) {
+                    children.push_back(population[i]);
+                    children.push_back(population[i + 1]);
+                }
+                inPlaceCrossingFunction(population[i], population[i + 1], children[0], children[1]);
+                std::swap(population[i], children[0]);
+                std::swap(population[i + 1], children[1]);
+            } else {
                 // Then cross it. Using move because Chromosome objects will no longer
                 // be needed
                 std::tie(population[i], population[i + 1]) = crossingFunction(
@@ -304,6 +458,23 @@ struct GenericCrossoverFunction : public CrossoverFunction<Fenotype, Eval> {
             }
         }
     }
+
+    void cross(const TypedChromosome& parentA, const TypedChromosome& parentB,
+        TypedChromosome& childA, TypedChromosome& childB) const override {
+        if (pairsToCrossing != 0) {
+            pairsToCrossing--;
+            childA = parentA;
+            childB = parentB;
+            return;
+        }
+        pairsToCrossing = crossingSkip.first(random);
+
+        if (inPlaceCrossingFunction) {
+            inPlaceCrossingFunction(parentA, parentB, childA, childB);
+        } else {
+            std::tie(childA, childB) = crossingFunction(parentA, parentB);
+        }
+    }
 };
 
 template <class Fenotype, class Eval>
@@ -321,17 +492,26 @@ struct GenericMutationFunction : public MutationFunction<Fenotype, Eval> {
     std::function<void(TypedChromosome&)> mutationFunction;
 
     // Random generator
-    RandomService& service = RandomService::getService();
-    std::function<bool(void)> isMutating = service.getBoolFunction(mutationProbability);
+    BulkRandom& random = BulkRandom::local();
+    GeometricSkip mutationSkip{ mutationProbability };
+
+    // Chromosomes left until the next mutation of the fused pipeline
+    mutable size_t chromosomesToMutation = mutationSkip.first(random);
 
     void operator()(Population& population) const override {
-        // Find mutating chromosomes
-        std::for_each(std::begin(population), std::end(population),
-            [&](TypedChromosome& chromosome) {
-                if (isMutating()) {
-                    mutationFunction(chromosome);
-                }
-            });
+        // Jump straight to mutating chromosomes
+        for (size_t i = mutationSkip.first(random); i < population.size(); i = mutationSkip.next(i, random)) {
+            mutationFunction(population[i]);
+        }
+    }
+
+    void mutate(TypedChromosome& chromosome) const override {
+        if (chromosomesToMutation != 0) {
+            chromosomesToMutation--;
+            return;
+        }
+        chromosomesToMutation = mutationSkip.first(random);
+        mutationFunction(chromosome);
     }
 };
 
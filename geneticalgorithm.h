@@ -14,7 +14,12 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef GENETICALGORITHM_H
 #define GENETICALGORITHM_H
+#include "allocationcounter.h"
+#include <algorithm>
+#include <chrono>
 #include <functional>
+#include <iostream>
+#include <iterator>
 #include <random>
 #include <vector>
 
@@ -23,7 +28,7 @@ template <class Fenotype, class Eval>
 struct Chromosome {
     using TypedChromosome = Chromosome<Fenotype, Eval>;
     Chromosome(Fenotype fenotype, Eval eval)
-        : fenotype(fenotype), lastEvaluation(eval) {
+        : fenotype(std::move(fenotype)), lastEvaluation(eval) {
     }
 
     Fenotype fenotype;
@@ -34,6 +39,54 @@ struct Chromosome {
     }
 };
 
+// Statistics of one generation, gathered in a single pass during evaluation
+template <class Eval>
+struct PopulationStatistics {
+    Eval min = Eval();
+    Eval max = Eval();
+    double mean = 0.0;
+    double variance = 0.0;
+    size_t bestIndex = 0;
+
+    // Diversity, filled by problem specific functions when given
+    double positionalEntropy = 0.0; // Mean entropy of genes per position, 0 to 1
+    double uniqueFraction = 1.0; // Fraction of distinct chromosome hashes
+
+    // Wall time of phases of the generation, filled by the engine
+    double selectionSeconds = 0.0;
+    double crossoverSeconds = 0.0;
+    double mutationSeconds = 0.0;
+    double evaluationSeconds = 0.0;
+};
+
+// Adds evaluations one by one (Welford's variance)
+template <class Eval>
+struct StatisticsAccumulator {
+    PopulationStatistics<Eval> statistics;
+    size_t count = 0;
+    double squaredDeviations = 0.0;
+
+    void add(const Eval evaluation) {
+        if (count == 0 || statistics.max < evaluation) {
+            statistics.max = evaluation;
+            statistics.bestIndex = count;
+        }
+        if (count == 0 || evaluation < statistics.min)
+            statistics.min = evaluation;
+
+        count++;
+        const double deviation = static_cast<double>(evaluation) - statistics.mean;
+        statistics.mean += deviation / static_cast<double>(count);
+        squaredDeviations += deviation * (static_cast<double>(evaluation) - statistics.mean);
+    }
+
+    PopulationStatistics<Eval> finish() {
+        if (count != 0)
+            statistics.variance = squaredDeviations / static_cast<double>(count);
+        return statistics;
+    }
+};
+
 template <class Fenotype, class Eval>
 struct InitializationFunction {
     using Population = std::vector<Chromosome<Fenotype, Eval>>;
@@ -47,7 +100,28 @@ struct EvaluationFunction {
     using Population = std::vector<Chromosome<Fenotype, Eval>>;
 
     virtual ~EvaluationFunction() = default;
-    virtual Eval operator()(Population&) const = 0;
+    virtual PopulationStatistics<Eval> operator()(Population&) const = 0;
+
+    // Fused pipeline: evaluates one offspring, then completes statistics of
+    // the whole generation. Default evaluates a population of one.
+    virtual Eval evaluate(Chromosome<Fenotype, Eval>& chromosome) const {
+        if (single.empty())
+            single.push_back(chromosome);
+        std::swap(single[0], chromosome);
+        const Eval evaluation = (*this)(single).max;
+        std::swap(single[0], chromosome);
+        return evaluation;
+    }
+    virtual void complete(const Population&, PopulationStatistics<Eval>&) const {}
+
+    // Fused pipeline with screening: false when fitness of the offspring is
+    // below threshold, evaluation may then stop early and leave it partial
+    virtual bool screen(Chromosome<Fenotype, Eval>& chromosome, Eval threshold) const {
+        return !(evaluate(chromosome) < threshold);
+    }
+
+private:
+    mutable Population single;
 };
 
 template <class Fenotype, class Eval>
@@ -55,7 +129,7 @@ struct StopCondition {
     using Population = std::vector<Chromosome<Fenotype, Eval>>;
 
     virtual ~StopCondition() = default;
-    virtual bool operator()(const Population&, const Eval&) = 0;
+    virtual bool operator()(const Population&, const PopulationStatistics<Eval>&) = 0;
 };
 
 template <class Fenotype, class Eval>
@@ -63,7 +137,7 @@ struct LoggingFunction {
     using Population = std::vector<Chromosome<Fenotype, Eval>>;
 
     virtual ~LoggingFunction() = default;
-    virtual void operator()(const Population&) = 0;
+    virtual void operator()(const Population&, const PopulationStatistics<Eval>&) = 0;
     virtual void show() const = 0;
 };
 
@@ -72,7 +146,23 @@ struct SelectionFunction {
     using Population = std::vector<Chromosome<Fenotype, Eval>>;
 
     virtual ~SelectionFunction() = default;
-    virtual Population operator()(const Population&) const = 0;
+    // Fills preallocated new population, its size may differ from the current one
+    virtual void operator()(const Population& population, Population& newPopulation) const = 0;
+
+    // Fused pipeline: one selected parent. Default selects a population of one,
+    // its result stays valid until the second next pick.
+    virtual const Chromosome<Fenotype, Eval>& pick(const Population& population) const {
+        Population& slot = picked[nextPick];
+        nextPick = 1 - nextPick;
+        if (slot.empty())
+            slot.push_back(population[0]);
+        (*this)(population, slot);
+        return slot[0];
+    }
+
+private:
+    mutable Population picked[2];
+    mutable size_t nextPick = 0;
 };
 
 template <class Fenotype, class Eval>
@@ -81,6 +171,25 @@ struct CrossoverFunction {
 
     virtual ~CrossoverFunction() = default;
     virtual void operator()(Population&) const = 0;
+
+    // Fused pipeline: writes children of the pair, crossed or copied. Default
+    // crosses a population of the two parents.
+    virtual void cross(const Chromosome<Fenotype, Eval>& parentA, const Chromosome<Fenotype, Eval>& parentB,
+        Chromosome<Fenotype, Eval>& childA, Chromosome<Fenotype, Eval>& childB) const {
+        if (pair.empty()) {
+            pair.push_back(parentA);
+            pair.push_back(parentB);
+        } else {
+            pair[0] = parentA;
+            pair[1] = parentB;
+        }
+        (*this)(pair);
+        std::swap(pair[0], childA);
+        std::swap(pair[1], childB);
+    }
+
+private:
+    mutable Population pair;
 };
 
 template <class Fenotype, class Eval>
@@ -89,6 +198,42 @@ struct MutationFunction {
 
     virtual ~MutationFunction() = default;
     virtual void operator()(Population&) const = 0;
+
+    // Fused pipeline: mutates one offspring with the configured probability.
+    // Default mutates a population of one.
+    virtual void mutate(Chromosome<Fenotype, Eval>& chromosome) const {
+        if (single.empty())
+            single.push_back(chromosome);
+        std::swap(single[0], chromosome);
+        (*this)(single);
+        std::swap(single[0], chromosome);
+    }
+
+private:
+    mutable Population single;
+};
+
+template <class Fenotype, class Eval>
+struct PopulationSizeFunction {
+    using Population = std::vector<Chromosome<Fenotype, Eval>>;
+
+    virtual ~PopulationSizeFunction() = default;
+    // Size of the next generation, given the evaluated current one
+    virtual size_t operator()(const Population& population, const PopulationStatistics<Eval>& statistics) = 0;
+    // May replace chromosomes of the selected generation, before crossing
+    virtual void reseed(Population& selected, const Population& previous, const PopulationStatistics<Eval>& statistics) = 0;
+    // May replace chromosomes of the crossed and mutated generation, before evaluation
+    virtual void restore(Population&, const Population&, const PopulationStatistics<Eval>&) {}
+};
+
+template <class Fenotype, class Eval>
+struct FixedPopulationSizeFunction : public PopulationSizeFunction<Fenotype, Eval> {
+    using Population = std::vector<Chromosome<Fenotype, Eval>>;
+
+    size_t operator()(const Population& population, const PopulationStatistics<Eval>&) override {
+        return population.size();
+    }
+    void reseed(Population&, const Population&, const PopulationStatistics<Eval>&) override {}
 };
 
 // Algorithm
@@ -106,23 +251,167 @@ struct GeneticAlgorithm {
         const SelectionFunction<Fenotype, Eval>& selectionFunction,
         const CrossoverFunction<Fenotype, Eval>& crossoverFunction,
         const MutationFunction<Fenotype, Eval>& mutationFunction) {
+        FixedPopulationSizeFunction<Fenotype, Eval> populationSizeFunction;
+        return optimize(initializationFunction, evaluationFunction, stopCondition, loggingFunction,
+            selectionFunction, crossoverFunction, mutationFunction, populationSizeFunction);
+    }
+
+    static Subject
+    optimize(const InitializationFunction<Fenotype, Eval>& initializationFunction,
+        const EvaluationFunction<Fenotype, Eval>& evaluationFunction,
+        StopCondition<Fenotype, Eval>& stopCondition,
+        LoggingFunction<Fenotype, Eval>& loggingFunction,
+
+        const SelectionFunction<Fenotype, Eval>& selectionFunction,
+        const CrossoverFunction<Fenotype, Eval>& crossoverFunction,
+        const MutationFunction<Fenotype, Eval>& mutationFunction,
+        PopulationSizeFunction<Fenotype, Eval>& populationSizeFunction) {
 
         // Initialization and first evaluation
         Population population = initializationFunction();
-        Eval evaluation = evaluationFunction(population);
-        loggingFunction(population);
+        PopulationStatistics<Eval> statistics = evaluationFunction(population);
+        loggingFunction(population, statistics);
+
+        // Second buffer, generations are swapped between the two
+        Population nextPopulation = population;
+        // Chromosomes dropped when shrinking, growing reuses their storage
+        Population spare;
+        size_t firstGenerationAllocations = AllocationCounter::count();
+
+        using Clock = std::chrono::steady_clock;
+        auto seconds = [](Clock::time_point from, Clock::time_point to) {
+            return std::chrono::duration<double>(to - from).count();
+        };
 
         // Main algorith loop
-        while (!stopCondition(population, evaluation)) {
-            population = selectionFunction(population);
+        for (size_t generation = 0; !stopCondition(population, statistics); generation++) {
+            const Clock::time_point start = Clock::now();
+
+            // Growing copies the best chromosome, selection overwrites it anyway
+            const size_t nextSize = std::max<size_t>(1, populationSizeFunction(population, statistics));
+            if (nextSize < nextPopulation.size()) {
+                std::move(std::begin(nextPopulation) + nextSize, std::end(nextPopulation), std::back_inserter(spare));
+                nextPopulation.erase(std::begin(nextPopulation) + nextSize, std::end(nextPopulation));
+            }
+            while (nextPopulation.size() < nextSize) {
+                if (spare.empty()) {
+                    nextPopulation.push_back(population[statistics.bestIndex]);
+                } else {
+                    nextPopulation.push_back(std::move(spare.back()));
+                    spare.pop_back();
+                    nextPopulation.back() = population[statistics.bestIndex];
+                }
+            }
+
+            selectionFunction(population, nextPopulation);
+            std::swap(population, nextPopulation);
+            populationSizeFunction.reseed(population, nextPopulation, statistics);
+            const Clock::time_point selected = Clock::now();
             crossoverFunction(population);
+            const Clock::time_point crossed = Clock::now();
             mutationFunction(population);
-            evaluation = evaluationFunction(population);
-            loggingFunction(population);
+            populationSizeFunction.restore(population, nextPopulation, statistics);
+            const Clock::time_point mutated = Clock::now();
+            statistics = evaluationFunction(population);
+            const Clock::time_point evaluated = Clock::now();
+
+            statistics.selectionSeconds = seconds(start, selected);
+            statistics.crossoverSeconds = seconds(selected, crossed);
+            statistics.mutationSeconds = seconds(crossed, mutated);
+            statistics.evaluationSeconds = seconds(mutated, evaluated);
+            loggingFunction(population, statistics);
+
+            if (generation == 0)
+                firstGenerationAllocations = AllocationCounter::count();
         }
 
+#ifdef GA_COUNT_ALLOCATIONS
+        std::cerr << "Allocations after first generation: "
+                  << AllocationCounter::count() - firstGenerationAllocations << "\n";
+#endif
+        (void)firstGenerationAllocations;
+
         // Returning best subject form population
-        return *std::max_element(std::cbegin(population), std::cend(population));
+        return population[statistics.bestIndex];
+    }
+
+    // Builds every offspring from selection to evaluation while it is hot in
+    // cache and writes it once into the next generation. Distribution matches
+    // optimize(): pairs of independently selected parents are crossed,
+    // mutated and evaluated. Population size is fixed. With screening,
+    // offspring worse than the worst chromosome of the current generation is
+    // dropped as soon as evaluation shows it and its parent is kept instead.
+    static Subject
+    optimizeFused(const InitializationFunction<Fenotype, Eval>& initializationFunction,
+        const EvaluationFunction<Fenotype, Eval>& evaluationFunction,
+        StopCondition<Fenotype, Eval>& stopCondition,
+        LoggingFunction<Fenotype, Eval>& loggingFunction,
+
+        const SelectionFunction<Fenotype, Eval>& selectionFunction,
+        const CrossoverFunction<Fenotype, Eval>& crossoverFunction,
+        const MutationFunction<Fenotype, Eval>& mutationFunction,
+        bool screening = false) {
+
+        // Initialization and first evaluation
+        Population population = initializationFunction();
+        PopulationStatistics<Eval> statistics = evaluationFunction(population);
+        loggingFunction(population, statistics);
+
+        Population nextPopulation = population;
+        size_t firstGenerationAllocations = AllocationCounter::count();
+
+        using Clock = std::chrono::steady_clock;
+
+        for (size_t generation = 0; !stopCondition(population, statistics); generation++) {
+            const Clock::time_point start = Clock::now();
+
+            StatisticsAccumulator<Eval> accumulator;
+            const Eval threshold = statistics.min;
+            auto finish = [&](Subject& child, const Subject& parent) {
+                mutationFunction.mutate(child);
+                if (!screening) {
+                    accumulator.add(evaluationFunction.evaluate(child));
+                    return;
+                }
+                // Copy reuses storage of the child, parent is already evaluated
+                if (!evaluationFunction.screen(child, threshold))
+                    child = parent;
+                accumulator.add(child.lastEvaluation);
+            };
+
+            const size_t size = nextPopulation.size();
+            for (size_t i = 0; i < size; i += 2) {
+                const Subject& parentA = selectionFunction.pick(population);
+                if (i + 1 < size) {
+                    const Subject& parentB = selectionFunction.pick(population);
+                    crossoverFunction.cross(parentA, parentB, nextPopulation[i], nextPopulation[i + 1]);
+                    finish(nextPopulation[i], parentA);
+                    finish(nextPopulation[i + 1], parentB);
+                } else {
+                    // Odd chromosome has no pair, like in staged crossing
+                    nextPopulation[i] = parentA;
+                    finish(nextPopulation[i], parentA);
+                }
+            }
+            std::swap(population, nextPopulation);
+            statistics = accumulator.finish();
+            evaluationFunction.complete(population, statistics);
+
+            // Phases are interleaved, whole generation is reported as evaluation
+            statistics.evaluationSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+            loggingFunction(population, statistics);
+
+            if (generation == 0)
+                firstGenerationAllocations = AllocationCounter::count();
+        }
+
+#ifdef GA_COUNT_ALLOCATIONS
+        std::cerr << "Allocations after first generation: "
+                  << AllocationCounter::count() - firstGenerationAllocations << "\n";
+#endif
+        (void)firstGenerationAllocations;
+
+        return population[statistics.bestIndex];
     }
 };
 
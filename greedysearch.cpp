@@ -16,22 +16,34 @@
 
 std::vector<uint> GreedySearch::search(
     std::function<std::vector<uint>(void)> initializationFunction,
-    std::function<uint(const std::vector<uint>&)> evaluationFunction) {
+    std::function<int64_t(const std::vector<uint>&)> evaluationFunction) {
+    // Every permutation is evaluated to the end, only better ones are kept
+    return search(initializationFunction,
+        [&evaluationFunction](const std::vector<uint>& permutation, int64_t bestFitness) -> std::optional<int64_t> {
+            const int64_t fitness = evaluationFunction(permutation);
+            return fitness > bestFitness ? std::optional<int64_t>(fitness) : std::nullopt;
+        });
+}
+
+std::vector<uint> GreedySearch::search(
+    std::function<std::vector<uint>(void)> initializationFunction,
+    std::function<std::optional<int64_t>(const std::vector<uint>&, int64_t)> screeningFunction) {
     std::vector<uint> basePermutation = initializationFunction();
 
     std::vector<uint> bestPermuatation;
-    uint bestFitness = 0;
+    int64_t bestFitness = std::numeric_limits<int64_t>::lowest();
 
     std::sort(std::begin(basePermutation), std::end(basePermutation));
     do {
-        uint fitness = evaluationFunction(basePermutation);
+        // Only permutations better than the best are evaluated to the end
+        const std::optional<int64_t> fitness = screeningFunction(basePermutation, bestFitness);
 
-        if (fitness > bestFitness) {
+        if (fitness) {
             bestPermuatation.clear();
             std::copy(std::begin(basePermutation), std::end(basePermutation),
                 std::back_inserter(bestPermuatation));
-            std::cout << "From: " << bestFitness << " to " << fitness << "\n";
-            bestFitness = fitness;
+            std::cout << "From: " << bestFitness << " to " << *fitness << "\n";
+            bestFitness = *fitness;
         }
     } while (std::next_permutation(
         std::begin(basePermutation), std::end(basePermutation)));
@@ -16,14 +16,22 @@
 #define GREEDYSEARCH_H
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <vector>
 
 namespace GreedySearch {
 std::vector<uint> search(
     std::function<std::vector<uint>(void)> initializationFunction,
-    std::function<uint(const std::vector<uint>&)> evaluationFunction);
+    std::function<int64_t(const std::vector<uint>&)> evaluationFunction);
+
+// Screening function returns fitness only when it is better than threshold
+std::vector<uint> search(
+    std::function<std::vector<uint>(void)> initializationFunction,
+    std::function<std::optional<int64_t>(const std::vector<uint>&, int64_t)> screeningFunction);
 };
 
 #endif // GREEDYSEARCH_H
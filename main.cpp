@@ -13,20 +13,36 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "error.cpp"
+#include "binaryproblem.h"
+#include "elitearchive.h"
+#include "factorygenetic.h"
 #include "factoryproblem.h"
+#include "fusedbenchmark.h"
 #include "generics.h"
 #include "geneticalgorithm.h"
 #include "greedysearch.h"
 #include "matrix.h"
+#include "paralleltempering.h"
+#include "qaplib.h"
+#include "racing.h"
 #include "randomsearch.h"
+#include "scalingbenchmark.h"
+#include "solverdaemon.h"
+#include "telemetry.h"
+#include "timetotarget.h"
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
 
 typedef unsigned int uint;
 
-using Eval = uint;
-
 const std::string PATH = "had20.dat";
 
 const size_t POPULATION_SIZE = 100;
@@ -35,78 +51,594 @@ const uint TOURNAMENT_SIZE = 100;
 const double CROSSING_PROBABILITY = 0.70;
 const double MUTATING_PROBABILITY = 0.20;
 
-int main() {
+const std::vector<size_t> SCALING_SIZES = { 20, 50, 100, 200, 500, 1000, 2000 };
+const size_t ARCHIVE_SIZE = 10;
+const std::vector<size_t> FUSED_POPULATION_SIZES = { 100, 1000, 10000, 100000 };
+const size_t DAEMON_TEMPERING_REPLICAS = 2; // Per request, workers already use all hardware threads
+
+std::optional<Qaplib::QaplibInstance> load(const std::string& path, Error& error) {
     // Input
     std::ifstream file;
-    file.open(PATH);
+    file.open(path);
+
+    if (!file) {
+        error = Error::FILE_NOT_FOUND;
+        return std::nullopt;
+    }
+
+    // Reading matrices
+    std::optional<Qaplib::QaplibInstance> read = Qaplib::readInstance(file);
+    if (!read)
+        error = Error::PARSE_ERROR;
+    return read;
+}
+
+// Whole argument as a number of the type, false and number unchanged otherwise
+template <class Number>
+bool parseNumber(const std::string& text, Number& number) {
+    std::istringstream is(text);
+    Number parsed;
+    if (text.empty() || (std::is_unsigned<Number>::value && text.find('-') != std::string::npos)
+        || !(is >> parsed) || !is.eof())
+        return false;
+    number = parsed;
+    return true;
+}
+
+// Arguments from the first one on as numbers
+template <class Number>
+bool parseNumbers(std::vector<std::string>::const_iterator first, std::vector<std::string>::const_iterator last, std::vector<Number>& numbers) {
+    for (; first != last; ++first) {
+        numbers.emplace_back();
+        if (!parseNumber(*first, numbers.back()))
+            return false;
+    }
+    return true;
+}
+
+FactoryProblem::GeneticConfiguration geneticConfiguration() {
+    FactoryProblem::GeneticConfiguration configuration;
+    configuration.populationSize = POPULATION_SIZE;
+    configuration.tournamentSize = TOURNAMENT_SIZE;
+    configuration.crossingProbability = CROSSING_PROBABILITY;
+    configuration.mutatingProbability = MUTATING_PROBABILITY;
+    return configuration;
+}
+
+struct SolveOptions {
+    std::string telemetryName; // Empty for the report written at the end
+    size_t generations = MAX_ITERATION_COUNT;
+    std::string archivePath; // Empty for runs without warm start
+};
+
+Error solve(const std::string& path, FactoryProblem::GeneticConfiguration configuration,
+    const SolveOptions& options = SolveOptions()) {
+    Error error = Error::NO_ERROR;
+    const std::optional<Qaplib::QaplibInstance> read = load(path, error);
+    if (!read)
+        return error;
+
+    const size_t matrixSize = read->size;
+    const FactoryProblem::FactoryInstance instance(read->distanceMatrix, read->flowMatrix);
+
+    // Warm start from best permutations of earlier runs of the same instance
+    const uint64_t checksum = Qaplib::checksum(*read);
+    if (!options.archivePath.empty()) {
+        for (const EliteArchive::Entry& entry : EliteArchive::load(options.archivePath, checksum, matrixSize, ARCHIVE_SIZE))
+            configuration.seeds.push_back(entry.locations);
+    }
+
+    auto serachInitializationFunction = [&]() -> std::vector<uint> {
+        std::vector<uint> init;
+        std::generate_n(std::back_inserter(init), matrixSize, [i = uint(0)]() mutable {
+            return i++;
+        });
+        return init;
+    };
+
+    auto searchEvaluationFunction = FactoryProblem::getFactoryPermutationEvaluationFunction(instance);
+
+    // Other types of algorithms
+    //        RandomSearch::search(serachInitializationFunction, searchEvaluationFunction, 1000);
+    //        GreedySearch::search(serachInitializationFunction, searchEvaluationFunction);
+    (void)serachInitializationFunction;
+
+    // Genetic algorithm
+    using Fenotype = FactoryProblem::FactoryFenotype;
+    using Eval = FactoryProblem::FactoryEval;
+
+    GenericIterationCountStopCondition<Fenotype, Eval> stopCondition(options.generations);
+
+    std::unique_ptr<LoggingFunction<Fenotype, Eval>> loggingFunction;
+    if (options.telemetryName.empty()) {
+        loggingFunction = std::make_unique<GenericJSLoggingFunction<Fenotype, Eval>>(FactoryProblem::factoryFitnessToResult, options.generations + 1);
+    } else {
+        // Live state is published for the monitor instead of the report written at the end
+        auto telemetryFunction = std::make_unique<Telemetry::TelemetryLoggingFunction<Fenotype, Eval>>(options.telemetryName, matrixSize,
+            FactoryProblem::factoryFitnessToResult,
+            [](const Fenotype& fenotype) -> const std::vector<uint>& { return fenotype.locations; });
+        if (!telemetryFunction->publisher.isOpen()) {
+            std::cerr << "Telemetry segment " << options.telemetryName << " cannot be created or is used by a running solver\n";
+            return Error::FILE_NOT_FOUND;
+        }
+        loggingFunction = std::move(telemetryFunction);
+    }
+
+    FactoryProblem::ScreeningCounters counters;
+    const Chromosome<Fenotype, Eval> found = FactoryProblem::runGeneticAlgorithm(instance, configuration, stopCondition, *loggingFunction, &counters);
+
+    loggingFunction->show();
+
+    if (!options.archivePath.empty()) {
+        const EliteArchive::Entry entry{ instance.kernels().cost(found.fenotype.locations), found.fenotype.locations };
+        if (!EliteArchive::store(options.archivePath, checksum, { entry }, ARCHIVE_SIZE))
+            return Error::FILE_NOT_FOUND;
+    }
+
+    std::cout << FactoryProblem::factoryFitnessToResult(found.lastEvaluation) << "\n";
+    if (configuration.screening) {
+        std::cout << "Rejected: " << counters.rejected << " of " << counters.evaluations << "\n"
+                  << "Skipped terms: " << 100.0 * counters.skippedTerms / std::max<uint64_t>(1, counters.terms) << "%\n";
+    }
+    return Error::NO_ERROR;
+}
+
+// <instance> [--telemetry name] [--generations count] [--adaptive min max] [--fused] [--screening] [--archive path]
+Error solveWithOptions(const std::vector<std::string>& arguments) {
+    if (arguments.empty())
+        return Error::INVALID_ARGUMENTS;
+
+    FactoryProblem::GeneticConfiguration configuration = geneticConfiguration();
+    SolveOptions options;
+    for (size_t i = 1; i < arguments.size(); i++) {
+        if (arguments[i] == "--telemetry" && (i + 1) < arguments.size())
+            options.telemetryName = arguments[++i];
+        else if (arguments[i] == "--generations" && (i + 1) < arguments.size()) {
+            if (!parseNumber(arguments[++i], options.generations))
+                return Error::INVALID_ARGUMENTS;
+        } else if (arguments[i] == "--archive" && (i + 1) < arguments.size())
+            options.archivePath = arguments[++i];
+        else if (arguments[i] == "--adaptive" && (i + 2) < arguments.size()) {
+            configuration.adaptivePopulationSize = true;
+            if (!parseNumber(arguments[++i], configuration.minPopulationSize) || !parseNumber(arguments[++i], configuration.maxPopulationSize))
+                return Error::INVALID_ARGUMENTS;
+        } else if (arguments[i] == "--fused")
+            configuration.fused = true;
+        else if (arguments[i] == "--screening")
+            configuration.screening = true;
+        else
+            return Error::INVALID_ARGUMENTS;
+    }
+    if (!FactoryProblem::isValid(configuration))
+        return Error::INVALID_ARGUMENTS;
+    return solve(arguments[0], configuration, options);
+}
+
+// monitor <name> [--once]
+Error monitor(const std::vector<std::string>& arguments) {
+    if (arguments.empty())
+        return Error::INVALID_ARGUMENTS;
+
+    const bool once = arguments.size() > 1 && arguments[1] == "--once";
+    const uint64_t nothingShown = std::numeric_limits<uint64_t>::max();
+    uint64_t shownGeneration = nothingShown;
+    Telemetry::Snapshot snapshot;
+    std::vector<uint32_t> genes;
+
+    while (Telemetry::read(arguments[0], snapshot, genes)) {
+        if (snapshot.generation != shownGeneration) {
+            shownGeneration = snapshot.generation;
+            std::cout << "Generation: " << snapshot.generation
+                      << " Population: " << snapshot.populationSize
+                      << " Best: " << snapshot.bestResult
+                      << " Mean: " << snapshot.meanResult
+                      << " Evals/s: " << snapshot.evaluationsPerSecond
+                      << " Phases [s]: " << snapshot.selectionSeconds << " " << snapshot.crossoverSeconds
+                      << " " << snapshot.mutationSeconds << " " << snapshot.evaluationSeconds << "\n";
+        }
+        if (once) {
+            for (uint32_t gene : genes)
+                std::cout << gene << " ";
+            std::cout << "\n";
+            return Error::NO_ERROR;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    // Segment is removed when the solver finishes
+    return shownGeneration == nothingShown ? Error::FILE_NOT_FOUND : Error::NO_ERROR;
+}
+
+// random <instance> [iterations]
+Error randomSearch(const std::vector<std::string>& arguments) {
+    if (arguments.empty())
+        return Error::INVALID_ARGUMENTS;
+
+    Error error = Error::NO_ERROR;
+    const std::optional<Qaplib::QaplibInstance> read = load(arguments[0], error);
+    if (!read)
+        return error;
+
+    size_t iterations = 100000;
+    if (arguments.size() > 1 && !parseNumber(arguments[1], iterations))
+        return Error::INVALID_ARGUMENTS;
+
+    const FactoryProblem::FactoryInstance instance(read->distanceMatrix, read->flowMatrix);
+
+    auto serachInitializationFunction = [&]() -> std::vector<uint> {
+        std::vector<uint> init(instance.size());
+        std::iota(std::begin(init), std::end(init), 0U);
+        return init;
+    };
+
+    // Random permutations are screened against the best one found so far
+    FactoryProblem::ScreeningCounters counters;
+    const std::vector<uint> found = RandomSearch::search(serachInitializationFunction,
+        FactoryProblem::getFactoryScreeningFunction(instance, counters), iterations);
+
+    std::cout << "Best: " << instance.kernels().cost(found) << "\n"
+              << "Rejected: " << counters.rejected << " of " << counters.evaluations << "\n"
+              << "Skipped terms: " << 100.0 * counters.skippedTerms / std::max<uint64_t>(1, counters.terms) << "%\n";
+    return Error::NO_ERROR;
+}
+
+// tempering <instance> [rounds] [replicas]
+Error tempering(const std::vector<std::string>& arguments) {
+    if (arguments.empty())
+        return Error::INVALID_ARGUMENTS;
+
+    Error error = Error::NO_ERROR;
+    const std::optional<Qaplib::QaplibInstance> read = load(arguments[0], error);
+    if (!read)
+        return error;
+
+    const FactoryProblem::FactoryInstance instance(read->distanceMatrix, read->flowMatrix);
+
+    ParallelTempering::Configuration configuration;
+    configuration.seed = RandomService::getService().getEngine()();
+    if ((arguments.size() > 1 && !parseNumber(arguments[1], configuration.maxRounds))
+        || (arguments.size() > 2 && !parseNumber(arguments[2], configuration.replicas)))
+        return Error::INVALID_ARGUMENTS;
 
-    if (file) {
-        // Reading matrix size
-        size_t matrixSize;
-        file >> matrixSize;
+    const auto start = std::chrono::steady_clock::now();
+    const FactoryProblem::FactoryChromosome found = ParallelTempering::search(instance, configuration);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-        // Skipping one line
-        file.ignore(1);
+    std::cout << FactoryProblem::factoryFitnessToResult(found.lastEvaluation) << " in " << elapsed.count() << " s\n";
+    return Error::NO_ERROR;
+}
+
+// Best known cost from the QAPLIB solution next to instance.dat, 0 without one
+FactoryProblem::FactoryCost bestKnownCost(const std::string& path, size_t size) {
+    const size_t extension = path.rfind(".dat");
+    std::ifstream file(path.substr(0, extension) + ".sln");
+    const std::optional<Qaplib::QaplibSolution> solution = file ? Qaplib::readSolution(file) : std::nullopt;
+    return solution && solution->size == size ? solution->cost : 0;
+}
+
+// Loads instance.dat[:best known] entries, best known cost defaults to the one
+// in instance.sln
+Error loadNamed(const std::vector<std::string>& entries,
+    std::vector<std::unique_ptr<FactoryProblem::FactoryInstance>>& loaded,
+    std::vector<TimeToTarget::NamedInstance>& instances) {
+    for (const std::string& entry : entries) {
+        const size_t separator = entry.rfind(':');
+        const std::string path = entry.substr(0, separator);
+        FactoryProblem::FactoryCost bestKnown = 0;
+        if (separator != std::string::npos && !parseNumber(entry.substr(separator + 1), bestKnown))
+            return Error::INVALID_ARGUMENTS;
+
+        Error error = Error::NO_ERROR;
+        const std::optional<Qaplib::QaplibInstance> read = load(path, error);
+        if (!read)
+            return error;
+
+        if (separator == std::string::npos)
+            bestKnown = bestKnownCost(path, read->size);
+
+        loaded.push_back(std::make_unique<FactoryProblem::FactoryInstance>(read->distanceMatrix, read->flowMatrix));
+        instances.push_back({ path, loaded.back().get(), bestKnown });
+    }
+    return Error::NO_ERROR;
+}
+
+// ttt <runs> <seconds per run> <instance.dat[:best known]>... [--solver ga|ga-adaptive|tempering] [--out records.csv] [--baseline records.csv]
+Error timeToTarget(const std::vector<std::string>& arguments) {
+    if (arguments.size() < 3)
+        return Error::INVALID_ARGUMENTS;
+
+    TimeToTarget::Configuration configuration;
+    if (!parseNumber(arguments[0], configuration.runs) || !parseNumber(arguments[1], configuration.timeLimit))
+        return Error::INVALID_ARGUMENTS;
+
+    std::vector<std::string> paths;
+    std::string solverName;
+    std::string outPath;
+    std::string baselinePath;
+    for (size_t i = 2; i < arguments.size(); i++) {
+        if (arguments[i] == "--solver" && (i + 1) < arguments.size())
+            solverName = arguments[++i];
+        else if (arguments[i] == "--out" && (i + 1) < arguments.size())
+            outPath = arguments[++i];
+        else if (arguments[i] == "--baseline" && (i + 1) < arguments.size())
+            baselinePath = arguments[++i];
+        else
+            paths.push_back(arguments[i]);
+    }
+
+    // Instances stay alive for the whole benchmark
+    std::vector<std::unique_ptr<FactoryProblem::FactoryInstance>> loaded;
+    std::vector<TimeToTarget::NamedInstance> instances;
+    const Error error = loadNamed(paths, loaded, instances);
+    if (error != Error::NO_ERROR)
+        return error;
+
+    std::vector<TimeToTarget::NamedSolver> solvers;
+    if (solverName.empty() || solverName == "ga")
+        solvers.push_back({ "ga", TimeToTarget::geneticSolver(geneticConfiguration()) });
+    if (solverName.empty() || solverName == "ga-adaptive") {
+        FactoryProblem::GeneticConfiguration adaptive = geneticConfiguration();
+        adaptive.adaptivePopulationSize = true;
+        solvers.push_back({ "ga-adaptive", TimeToTarget::geneticSolver(adaptive) });
+    }
+    if (solverName.empty() || solverName == "tempering")
+        solvers.push_back({ "tempering", TimeToTarget::temperingSolver(ParallelTempering::Configuration()) });
+    if (solvers.empty() || instances.empty())
+        return Error::INVALID_ARGUMENTS;
+
+    const std::vector<TimeToTarget::Record> records = TimeToTarget::run(solvers, instances, configuration);
+
+    if (!outPath.empty()) {
+        std::ofstream out(outPath);
+        TimeToTarget::writeRecords(out, records);
+    }
+
+    std::vector<TimeToTarget::Record> baseline;
+    if (!baselinePath.empty()) {
+        std::ifstream in(baselinePath);
+        if (!in)
+            return Error::FILE_NOT_FOUND;
+        baseline = TimeToTarget::readRecords(in);
+    }
+
+    TimeToTarget::report(std::cout, records, baseline, configuration.significance);
+    return Error::NO_ERROR;
+}
+
+// tune <cpu seconds> <instance.dat[:best known]>... [--run-seconds seconds] [--iterations count] [--threads count]
+Error tune(const std::vector<std::string>& arguments) {
+    if (arguments.size() < 2)
+        return Error::INVALID_ARGUMENTS;
+
+    Racing::Configuration configuration;
+    if (!parseNumber(arguments[0], configuration.cpuBudget))
+        return Error::INVALID_ARGUMENTS;
+
+    std::vector<std::string> paths;
+    for (size_t i = 1; i < arguments.size(); i++) {
+        bool parsed = true;
+        if (arguments[i] == "--run-seconds" && (i + 1) < arguments.size())
+            parsed = parseNumber(arguments[++i], configuration.runSeconds);
+        else if (arguments[i] == "--iterations" && (i + 1) < arguments.size())
+            parsed = parseNumber(arguments[++i], configuration.iterations);
+        else if (arguments[i] == "--threads" && (i + 1) < arguments.size())
+            parsed = parseNumber(arguments[++i], configuration.threads);
+        else
+            paths.push_back(arguments[i]);
+        if (!parsed)
+            return Error::INVALID_ARGUMENTS;
+    }
 
-        // Reading matrix
-        Matrix distanceMatrix(matrixSize, matrixSize);
-        Matrix flowMatrix(matrixSize, matrixSize);
+    std::vector<std::unique_ptr<FactoryProblem::FactoryInstance>> loaded;
+    std::vector<TimeToTarget::NamedInstance> instances;
+    const Error error = loadNamed(paths, loaded, instances);
+    if (error != Error::NO_ERROR)
+        return error;
+    if (instances.empty())
+        return Error::INVALID_ARGUMENTS;
 
-        file >> flowMatrix >> distanceMatrix;
+    const Racing::Result result = Racing::tune(instances, geneticConfiguration(), configuration, std::cerr);
+    std::cout << Racing::describe(result.configuration) << "\n"
+              << "Relative cost " << result.meanRelativeCost << " over " << result.blocks << " blocks, "
+              << result.runs << " runs in " << result.cpuSeconds << " CPU s\n";
+    return Error::NO_ERROR;
+}
+
+// daemon <socket> [workers] [cache size]
+Error daemon(const std::vector<std::string>& arguments) {
+    if (arguments.empty())
+        return Error::INVALID_ARGUMENTS;
+
+    SolverDaemon::Configuration configuration;
+    configuration.socketPath = arguments[0];
+    if ((arguments.size() > 1 && !parseNumber(arguments[1], configuration.workers))
+        || (arguments.size() > 2 && !parseNumber(arguments[2], configuration.cacheCapacity)))
+        return Error::INVALID_ARGUMENTS;
+
+    ParallelTempering::Configuration tempering;
+    tempering.replicas = DAEMON_TEMPERING_REPLICAS;
+    const std::vector<TimeToTarget::NamedSolver> solvers = {
+        { "ga", TimeToTarget::geneticSolver(geneticConfiguration()) },
+        { "tempering", TimeToTarget::temperingSolver(tempering) }
+    };
+    if (!SolverDaemon::serve(configuration, solvers, std::cerr))
+        return Error::FILE_NOT_FOUND;
+    return Error::NO_ERROR;
+}
+
+// client <socket> <request...> [--cancel-after seconds]
+Error client(const std::vector<std::string>& arguments) {
+    if (arguments.size() < 2)
+        return Error::INVALID_ARGUMENTS;
+
+    std::string line;
+    double cancelAfter = 0.0;
+    for (size_t i = 1; i < arguments.size(); i++) {
+        if (arguments[i] == "--cancel-after" && (i + 1) < arguments.size()) {
+            if (!parseNumber(arguments[++i], cancelAfter))
+                return Error::INVALID_ARGUMENTS;
+        } else {
+            line += line.empty() ? "" : " ";
+            line += arguments[i];
+        }
+    }
+
+    if (!SolverDaemon::request(arguments[0], line, std::cout, cancelAfter))
+        return Error::FILE_NOT_FOUND;
+    return Error::NO_ERROR;
+}
 
-        auto serachInitializationFunction = [&]() -> std::vector<uint> {
-            std::vector<uint> init;
-            std::generate_n(std::back_inserter(init), matrixSize, [i = uint(0)]() mutable {
-                return i++;
-            });
-            return init;
-        };
+// binary <onemax|knapsack> <bits> [generations]
+Error binary(const std::vector<std::string>& arguments) {
+    if (arguments.size() < 2)
+        return Error::INVALID_ARGUMENTS;
 
-        auto searchEvaluationFunction = [&](const std::vector<uint>& permuatation) -> uint {
-            uint base = 10000U;
-            for (size_t i = 0; i < permuatation.size(); i++) {
-                const std::vector<uint> flowRow = flowMatrix[permuatation[i]];
-                const std::vector<uint> distanceRow = distanceMatrix[i];
+    using Fenotype = BinaryProblem::BinaryFenotype;
+    using Eval = BinaryProblem::BinaryEval;
 
-                for (size_t j = (i + 1); j < permuatation.size(); j++) {
-                    base -= 2 * (flowRow[permuatation[j]] * distanceRow[j]);
-                }
-            }
-            return base;
-        };
+    size_t numberOfBits = 0;
+    size_t generations = MAX_ITERATION_COUNT;
+    if (!parseNumber(arguments[1], numberOfBits) || numberOfBits == 0
+        || (arguments.size() > 2 && !parseNumber(arguments[2], generations)))
+        return Error::INVALID_ARGUMENTS;
 
-        // Other types of algorithms
-        //        RandomSearch::search(serachInitializationFunction, searchEvaluationFunction, 1000);
-        //        GreedySearch::search(serachInitializationFunction, searchEvaluationFunction);
+    std::function<Eval(Chromosome<Fenotype, Eval>&)> evalFunction;
+    if (arguments[0] == "onemax")
+        evalFunction = BinaryProblem::getOneMaxEvaluationFunction();
+    else if (arguments[0] == "knapsack")
+        evalFunction = BinaryProblem::getKnapsackEvaluationFunction(BinaryProblem::KnapsackInstance::generate(numberOfBits, 1));
+    else
+        return Error::INVALID_ARGUMENTS;
 
-        // Genetic algorithm
-        using Fenotype = FactoryProblem::FactoryFenotype;
-        using Eval = uint;
+    GenericRandomInitializationFunction<Fenotype, Eval> initializationFunction(POPULATION_SIZE, numberOfBits, BinaryProblem::getBinaryRandomInitializationFunction(numberOfBits));
+    GenericEvaluationFunction<Fenotype, Eval> evaluationFunction(evalFunction);
+    GenericIterationCountStopCondition<Fenotype, Eval> stopCondition(generations);
+    GenericNoLoggingFunction<Fenotype, Eval> loggingFunction;
 
-        GenericRandomInitializationFunction<Fenotype, Eval> initializationFunction(POPULATION_SIZE, matrixSize, FactoryProblem::getFactoryRandomInitializationFunction(matrixSize));
-        GenericEvaluationFunction<Fenotype, Eval> evaluationFunction(FactoryProblem::getFactoryEvaluationFunction(distanceMatrix, flowMatrix));
-        GenericIterationCountStopCondition<Fenotype, Eval> stopCondition(MAX_ITERATION_COUNT);
-        GenericJSLoggingFunction<Fenotype, Eval> loggingFunction(FactoryProblem::factoryFitnessToResult);
+    // Every chromosome mutates, on average one bit of it
+    GenericTournamentSelectionFunction<Fenotype, Eval> selectionFunction(4);
+    GenericCrossoverFunction<Fenotype, Eval> crossoverFunction(CROSSING_PROBABILITY, BinaryProblem::binaryInPlaceUniformCrossingFunction);
+    GenericMutationFunction<Fenotype, Eval> mutationFunction(1.0, BinaryProblem::getBinaryBitFlipMutationFunction(1.0 / numberOfBits));
 
-        GenericTournamentSelectionFunction<Fenotype, Eval> selectionFunction(TOURNAMENT_SIZE, POPULATION_SIZE);
-        GenericCrossoverFunction<Fenotype, Eval> crossoverFunction(CROSSING_PROBABILITY, FactoryProblem::factorySymetricOXCrossingFunction);
-        GenericMutationFunction<Fenotype, Eval> mutationFunction(MUTATING_PROBABILITY, FactoryProblem::factorySwapMuatationFunction);
+    const auto start = std::chrono::steady_clock::now();
+    const Chromosome<Fenotype, Eval> found = GeneticAlgorithm<Fenotype, Eval>::optimize(
+        initializationFunction,
+        evaluationFunction,
+        stopCondition,
+        loggingFunction,
 
-        const Chromosome<Fenotype, Eval> found = GeneticAlgorithm<Fenotype, Eval>::optimize(
-            std::ref(initializationFunction),
-            std::ref(evaluationFunction),
-            std::ref(stopCondition),
-            std::ref(loggingFunction),
+        selectionFunction,
+        crossoverFunction,
+        mutationFunction);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-            std::ref(selectionFunction),
-            std::ref(crossoverFunction),
-            std::ref(mutationFunction));
+    std::cout << found.lastEvaluation << " in " << elapsed.count() << " s\n";
+    return Error::NO_ERROR;
+}
 
-        loggingFunction.show();
+// generate <uniform|structured|sparse> <size> <seed> [flow density]
+Error generate(const std::vector<std::string>& arguments) {
+    if (arguments.size() < 3)
+        return Error::INVALID_ARGUMENTS;
 
-        std::cout << FactoryProblem::factoryFitnessToResult(found.lastEvaluation) << "\n";
-        return static_cast<int>(Error::NO_ERROR);
+    const std::optional<Qaplib::GeneratorKind> kind = Qaplib::generatorKindFromString(arguments[0]);
+    if (!kind)
+        return Error::INVALID_ARGUMENTS;
+
+    size_t size = 0;
+    uint64_t seed = 0;
+    double density = Qaplib::DEFAULT_FLOW_DENSITY;
+    if (!parseNumber(arguments[1], size) || !parseNumber(arguments[2], seed)
+        || (arguments.size() > 3 && !parseNumber(arguments[3], density)))
+        return Error::INVALID_ARGUMENTS;
+
+    Qaplib::writeInstance(std::cout, Qaplib::generate(*kind, size, seed, density));
+    return Error::NO_ERROR;
+}
+
+// scaling <uniform|structured|sparse> <seed> [sizes...]
+Error scaling(const std::vector<std::string>& arguments) {
+    if (arguments.size() < 2)
+        return Error::INVALID_ARGUMENTS;
+
+    const std::optional<Qaplib::GeneratorKind> kind = Qaplib::generatorKindFromString(arguments[0]);
+    if (!kind)
+        return Error::INVALID_ARGUMENTS;
+
+    uint64_t seed = 0;
+    std::vector<size_t> sizes;
+    if (!parseNumber(arguments[1], seed) || !parseNumbers(std::cbegin(arguments) + 2, std::cend(arguments), sizes))
+        return Error::INVALID_ARGUMENTS;
+
+    ScalingBenchmark::run(std::cout, *kind, seed, sizes.empty() ? SCALING_SIZES : sizes);
+    return Error::NO_ERROR;
+}
+
+// fused <instance.dat> <generations> [population sizes...]
+Error fused(const std::vector<std::string>& arguments) {
+    if (arguments.size() < 2)
+        return Error::INVALID_ARGUMENTS;
+
+    size_t generations = 0;
+    std::vector<size_t> sizes;
+    if (!parseNumber(arguments[1], generations) || !parseNumbers(std::cbegin(arguments) + 2, std::cend(arguments), sizes))
+        return Error::INVALID_ARGUMENTS;
+
+    Error error = Error::NO_ERROR;
+    const std::optional<Qaplib::QaplibInstance> read = load(arguments[0], error);
+    if (!read)
+        return error;
+
+    FusedBenchmark::run(std::cout, *read, geneticConfiguration(), sizes.empty() ? FUSED_POPULATION_SIZES : sizes,
+        generations, 3);
+    return Error::NO_ERROR;
+}
+
+int main(int argc, char* argv[]) {
+    const std::vector<std::string> arguments(argv + 1, argv + argc);
+
+    Error error = Error::NO_ERROR;
+    if (arguments.empty()) {
+        error = solve(PATH, geneticConfiguration());
+    } else if (arguments[0] == "generate") {
+        error = generate({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "random") {
+        error = randomSearch({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "tempering") {
+        error = tempering({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "ttt") {
+        error = timeToTarget({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "tune") {
+        error = tune({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "daemon") {
+        error = daemon({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "client") {
+        error = client({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "binary") {
+        error = binary({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "scaling") {
+        error = scaling({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "fused") {
+        error = fused({ std::begin(arguments) + 1, std::end(arguments) });
+    } else if (arguments[0] == "monitor") {
+        error = monitor({ std::begin(arguments) + 1, std::end(arguments) });
+    } else {
+        error = solveWithOptions(arguments);
     }
 
-    return static_cast<int>(Error::NO_ERROR);
+    if (error == Error::INVALID_ARGUMENTS) {
+        std::cerr << "Usage: " << argv[0] << " [instance.dat] [--telemetry name] [--generations count] [--adaptive min max] [--fused] [--screening] [--archive path]\n"
+                  << "       " << argv[0] << " monitor <name> [--once]\n"
+                  << "       " << argv[0] << " random <instance.dat> [iterations]\n"
+                  << "       " << argv[0] << " tempering <instance.dat> [rounds] [replicas]\n"
+                  << "       " << argv[0] << " ttt <runs> <seconds> <instance.dat[:best known]>... [--solver ga|ga-adaptive|tempering] [--out records.csv] [--baseline records.csv]\n"
+                  << "       " << argv[0] << " tune <cpu seconds> <instance.dat[:best known]>... [--run-seconds seconds] [--iterations count] [--threads count]\n"
+                  << "       " << argv[0] << " daemon <socket> [workers] [cache size]\n"
+                  << "       " << argv[0] << " client <socket> <solve <instance.dat> <seconds> [ga|tempering]|stats|shutdown> [--cancel-after seconds]\n"
+                  << "       " << argv[0] << " binary <onemax|knapsack> <bits> [generations]\n"
+                  << "       " << argv[0] << " generate <uniform|structured|sparse> <size> <seed> [flow density]\n"
+                  << "       " << argv[0] << " scaling <uniform|structured|sparse> <seed> [sizes...]\n"
+                  << "       " << argv[0] << " fused <instance.dat> <generations> [population sizes...]\n";
+    }
+    return static_cast<int>(error);
 }
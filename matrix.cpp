@@ -14,27 +14,12 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "matrix.h"
 
-Matrix::Matrix(size_t cols, size_t rows)
-    : cols(cols), rows(rows) {
-    matrix.resize(rows);
-    for (auto& row : matrix) {
-        row.resize(cols);
-    }
-}
-
-vector<uint>& Matrix::operator[](size_t index) {
-    return matrix[index];
-}
-const vector<uint>& Matrix::operator[](size_t index) const {
-    return matrix[index];
-}
-
-istream& operator>>(istream& ios, Matrix& matrix) {
-    for (size_t column = 0; column < matrix.cols; column++) {
-        for (size_t row = 0; row < matrix.rows; row++) {
-            ios >> matrix[column][row];
-        }
-    }
-
-    return ios;
-}
+template class Matrix<uint8_t>;
+template class Matrix<uint16_t>;
+template class Matrix<uint32_t>;
+template class SymmetricMatrix<uint8_t>;
+template class SymmetricMatrix<uint16_t>;
+template class SymmetricMatrix<uint32_t>;
+template class SparseMatrix<uint8_t>;
+template class SparseMatrix<uint16_t>;
+template class SparseMatrix<uint32_t>;
@@ -16,6 +16,7 @@
 #define MATRIX_H
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 
@@ -23,20 +24,167 @@ using std::istream;
 using std::vector;
 typedef unsigned int uint;
 
+// Square matrices are stored row after row in one contiguous block, so that
+// rows can be streamed by the evaluation kernels. Element type is chosen by
+// the loader to be the narrowest one holding all values of an instance.
+template <class Element>
 class Matrix {
 public:
-    Matrix(size_t cols, size_t rows);
+    using ElementType = Element;
 
-    vector<uint>& operator[](size_t index);
-    const vector<uint>& operator[](size_t index) const;
+    Matrix(size_t cols, size_t rows)
+        : cols(cols), rows(rows), matrix(cols * rows) {
+    }
+
+    // Converting copy, caller is responsible for values fitting in Element
+    template <class Other>
+    explicit Matrix(const Matrix<Other>& other)
+        : cols(other.cols), rows(other.rows), matrix(cols * rows) {
+        for (size_t row = 0; row < rows; row++) {
+            std::transform(other[row], other[row] + cols, (*this)[row],
+                [](const Other value) { return static_cast<Element>(value); });
+        }
+    }
+
+    Element* operator[](size_t index) { return matrix.data() + index * cols; }
+    const Element* operator[](size_t index) const { return matrix.data() + index * cols; }
+    Element at(size_t row, size_t col) const { return matrix[row * cols + col]; }
+    size_t bytes() const { return matrix.size() * sizeof(Element); }
+
+    Element maxElement() const {
+        return matrix.empty() ? Element() : *std::max_element(std::cbegin(matrix), std::cend(matrix));
+    }
+
+    bool isSymmetric() const {
+        for (size_t row = 0; row < rows; row++) {
+            for (size_t col = (row + 1); col < cols; col++) {
+                if (at(row, col) != at(col, row))
+                    return false;
+            }
+        }
+        return cols == rows;
+    }
+
+    size_t nonZeros() const {
+        return static_cast<size_t>(std::count_if(std::cbegin(matrix), std::cend(matrix),
+            [](const Element value) { return value != Element(); }));
+    }
+
+    bool hasZeroDiagonal() const {
+        for (size_t index = 0; index < std::min(cols, rows); index++) {
+            if (at(index, index) != Element())
+                return false;
+        }
+        return true;
+    }
 
     const size_t cols = 0;
     const size_t rows = 0;
 
 private:
-    vector<vector<uint>> matrix;
+    vector<Element> matrix;
+};
+
+// Symmetric square matrix keeping only the upper triangle with diagonal.
+// Row index is the smaller of the two indexes, so row(i)[j - i] is (i, j)
+// for j >= i and rows stay contiguous for the evaluation kernels.
+template <class Element>
+class SymmetricMatrix {
+public:
+    using ElementType = Element;
+
+    template <class Other>
+    explicit SymmetricMatrix(const Matrix<Other>& other)
+        : size(other.rows), rowBase(size), matrix(size * (size + 1) / 2) {
+        size_t offset = 0;
+        for (size_t row = 0; row < size; row++) {
+            rowBase[row] = offset - row;
+            std::transform(other[row] + row, other[row] + size, matrix.data() + offset,
+                [](const Other value) { return static_cast<Element>(value); });
+            offset += size - row;
+        }
+    }
+
+    // Stored part of the row, indexed by column from the diagonal on
+    const Element* upper(size_t index) const { return matrix.data() + rowBase[index]; }
+    const Element* row(size_t index) const { return upper(index) + index; }
+    // Element from the row of the smaller index, selected without branching
+    Element at(size_t row, size_t col) const {
+        const size_t lower = std::min(row, col);
+        return matrix[rowBase[lower] + row + col - lower];
+    }
+    size_t bytes() const { return matrix.size() * sizeof(Element) + rowBase.size() * sizeof(size_t); }
+
+    const size_t size = 0;
+
+private:
+    vector<size_t> rowBase; // Offset of row start minus row index
+    vector<Element> matrix;
+};
+
+// Square matrix in compressed sparse row form, only nonzero elements are
+// stored. Elements of row i are at indexes [rowBegin(i), rowEnd(i)), ordered by
+// column. Transposed copy gives the columns of the original as rows.
+template <class Element>
+class SparseMatrix {
+public:
+    using ElementType = Element;
+
+    template <class Other>
+    explicit SparseMatrix(const Matrix<Other>& other, bool transposed = false)
+        : size(other.rows), rowStart(size + 1) {
+        for (size_t row = 0; row < size; row++) {
+            rowStart[row] = columns.size();
+            for (size_t col = 0; col < size; col++) {
+                const Other value = transposed ? other.at(col, row) : other.at(row, col);
+                if (value != Other()) {
+                    columns.push_back(static_cast<uint32_t>(col));
+                    values.push_back(static_cast<Element>(value));
+                }
+            }
+        }
+        rowStart[size] = columns.size();
+    }
+
+    size_t rowBegin(size_t row) const { return rowStart[row]; }
+    size_t rowEnd(size_t row) const { return rowStart[row + 1]; }
+    uint32_t column(size_t index) const { return columns[index]; }
+    Element value(size_t index) const { return values[index]; }
+    size_t nonZeros() const { return values.size(); }
+    size_t bytes() const {
+        return rowStart.size() * sizeof(size_t) + columns.size() * sizeof(uint32_t) + values.size() * sizeof(Element);
+    }
+
+    const size_t size = 0;
+
+private:
+    vector<size_t> rowStart;
+    vector<uint32_t> columns;
+    vector<Element> values;
 };
 
-istream& operator>>(istream& is, Matrix& matrix);
+template <class Element>
+istream& operator>>(istream& ios, Matrix<Element>& matrix) {
+    // Reading through uint so that uint8_t is not read as a character
+    uint value = 0;
+    for (size_t column = 0; column < matrix.cols; column++) {
+        for (size_t row = 0; row < matrix.rows; row++) {
+            ios >> value;
+            matrix[column][row] = static_cast<Element>(value);
+        }
+    }
+
+    return ios;
+}
+
+extern template class Matrix<uint8_t>;
+extern template class Matrix<uint16_t>;
+extern template class Matrix<uint32_t>;
+extern template class SymmetricMatrix<uint8_t>;
+extern template class SymmetricMatrix<uint16_t>;
+extern template class SymmetricMatrix<uint32_t>;
+extern template class SparseMatrix<uint8_t>;
+extern template class SparseMatrix<uint16_t>;
+extern template class SparseMatrix<uint32_t>;
 
 #endif // MATRIX_H
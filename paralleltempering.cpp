@@ -0,0 +1,196 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "paralleltempering.h"
+#include "bulkrandom.h"
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace {
+using FactoryProblem::FactoryDelta;
+
+// Shared state of one replica, each on its own cache line
+struct alignas(64) ReplicaSlot {
+    std::atomic<FactoryDelta> cost{ 0 };
+    std::atomic<FactoryDelta> bestCost{ std::numeric_limits<FactoryDelta>::max() };
+    std::atomic<size_t> temperatureIndex{ 0 };
+};
+
+std::vector<uint> randomLocations(size_t numberOfLocations, BulkRandom& random) {
+    std::vector<uint> locations(numberOfLocations);
+    std::iota(std::begin(locations), std::end(locations), 0U);
+    for (size_t i = numberOfLocations; i > 1; i--) {
+        std::swap(locations[i - 1], locations[random.nextBelow(static_cast<uint32_t>(i))]);
+    }
+    return locations;
+}
+
+// Mean cost increase of uphill swaps from a random assignment
+double meanUphillDelta(const FactoryProblem::FactoryKernels& kernels, size_t numberOfLocations, BulkRandom& random) {
+    const std::vector<uint> locations = randomLocations(numberOfLocations, random);
+    const uint32_t range = static_cast<uint32_t>(numberOfLocations);
+
+    double sum = 0.0;
+    size_t uphill = 0;
+    for (size_t sample = 0; sample < 1000; sample++) {
+        const FactoryDelta delta = kernels.swapDelta(locations, random.nextBelow(range), random.nextBelow(range));
+        if (delta > 0) {
+            sum += static_cast<double>(delta);
+            uphill++;
+        }
+    }
+    return uphill == 0 ? 1.0 : sum / uphill;
+}
+} // namespace
+
+FactoryProblem::FactoryChromosome ParallelTempering::search(
+    const FactoryProblem::FactoryInstance& instance, const Configuration& configuration) {
+    const FactoryProblem::FactoryKernels& kernels = instance.kernels();
+    const size_t numberOfLocations = instance.size();
+    const size_t replicas = std::max<size_t>(2, configuration.replicas);
+
+    // Geometric ladder, hottest accepts a mean uphill move half of the time
+    // and coldest one in a million times
+    BulkRandom ladderRandom(configuration.seed);
+    double minTemperature = configuration.minTemperature;
+    double maxTemperature = configuration.maxTemperature;
+    if (minTemperature <= 0.0 || maxTemperature <= 0.0) {
+        const double uphill = meanUphillDelta(kernels, numberOfLocations, ladderRandom);
+        maxTemperature = uphill / std::log(2.0);
+        minTemperature = uphill / std::log(1e6);
+    }
+
+    std::vector<double> temperatures(replicas);
+    for (size_t i = 0; i < replicas; i++) {
+        temperatures[i] = minTemperature * std::pow(maxTemperature / minTemperature, static_cast<double>(i) / (replicas - 1));
+    }
+
+    std::vector<ReplicaSlot> slots(replicas);
+    std::vector<std::vector<uint>> bestLocations(replicas);
+    std::atomic<size_t> arrived{ 0 };
+    std::atomic<size_t> released{ 0 };
+    std::atomic<bool> stop{ numberOfLocations < 2 || configuration.maxRounds == 0 };
+
+    auto replica = [&](size_t index) {
+        BulkRandom random(configuration.seed + 1 + index);
+        std::vector<uint> locations = randomLocations(numberOfLocations, random);
+        FactoryDelta cost = static_cast<FactoryDelta>(kernels.cost(locations));
+
+        // Positions of facilities, sparse kernels use them to skip zero flows
+        std::vector<uint> positions(numberOfLocations);
+        for (size_t i = 0; i < numberOfLocations; i++) {
+            positions[locations[i]] = static_cast<uint>(i);
+        }
+
+        ReplicaSlot& slot = slots[index];
+        slot.temperatureIndex.store(index);
+        bestLocations[index] = locations;
+        slot.bestCost.store(cost);
+
+        // Coordinator owns the map of temperatures to replicas
+        std::vector<size_t> replicaAt(replicas);
+        std::iota(std::begin(replicaAt), std::end(replicaAt), 0U);
+        BulkRandom exchangeRandom(configuration.seed + replicas + 1);
+
+        const uint32_t range = static_cast<uint32_t>(numberOfLocations);
+        for (size_t round = 0; !stop.load(std::memory_order_acquire); round++) {
+            const double temperature = temperatures[slot.temperatureIndex.load(std::memory_order_relaxed)];
+            FactoryDelta bestCost = slot.bestCost.load(std::memory_order_relaxed);
+
+            for (size_t move = 0; move < configuration.movesPerRound; move++) {
+                const uint r = random.nextBelow(range);
+                uint s = random.nextBelow(range - 1);
+                if (s >= r)
+                    s++;
+
+                const FactoryDelta delta = kernels.indexedSwapDelta(locations, positions, r, s);
+                if (delta <= 0 || random.nextDouble() < std::exp(-static_cast<double>(delta) / temperature)) {
+                    std::swap(locations[r], locations[s]);
+                    positions[locations[r]] = r;
+                    positions[locations[s]] = s;
+                    cost += delta;
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestLocations[index] = locations;
+                    }
+                }
+            }
+            slot.cost.store(cost, std::memory_order_relaxed);
+            slot.bestCost.store(bestCost, std::memory_order_relaxed);
+            arrived.fetch_add(1, std::memory_order_acq_rel);
+
+            if (index == 0) {
+                // Wait for all replicas, then exchange neighbouring temperatures,
+                // even pairs on even rounds and odd pairs on odd ones
+                while (arrived.load(std::memory_order_acquire) < replicas * (round + 1)) {
+                    std::this_thread::yield();
+                }
+
+                for (size_t t = round % 2; (t + 1) < replicas; t += 2) {
+                    ReplicaSlot& colder = slots[replicaAt[t]];
+                    ReplicaSlot& hotter = slots[replicaAt[t + 1]];
+                    const double exponent = (static_cast<double>(colder.cost.load(std::memory_order_relaxed))
+                                                - static_cast<double>(hotter.cost.load(std::memory_order_relaxed)))
+                        * (1.0 / temperatures[t] - 1.0 / temperatures[t + 1]);
+                    if (exponent >= 0.0 || exchangeRandom.nextDouble() < std::exp(exponent)) {
+                        std::swap(replicaAt[t], replicaAt[t + 1]);
+                        slots[replicaAt[t]].temperatureIndex.store(t, std::memory_order_relaxed);
+                        slots[replicaAt[t + 1]].temperatureIndex.store(t + 1, std::memory_order_relaxed);
+                    }
+                }
+
+                FactoryDelta globalBest = std::numeric_limits<FactoryDelta>::max();
+                for (const ReplicaSlot& other : slots) {
+                    globalBest = std::min(globalBest, other.bestCost.load(std::memory_order_relaxed));
+                }
+
+                const size_t moves = (round + 1) * replicas * configuration.movesPerRound;
+                if ((round + 1) >= configuration.maxRounds
+                    || (configuration.progressFunction
+                           && !configuration.progressFunction(FactoryProblem::factoryCostToFitness(static_cast<FactoryProblem::FactoryCost>(globalBest)), moves))) {
+                    stop.store(true, std::memory_order_release);
+                }
+                released.store(round + 1, std::memory_order_release);
+            } else {
+                while (released.load(std::memory_order_acquire) < (round + 1)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t index = 1; index < replicas; index++) {
+        threads.emplace_back(replica, index);
+    }
+    replica(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Best of all replicas
+    size_t best = 0;
+    for (size_t index = 1; index < replicas; index++) {
+        if (slots[index].bestCost.load() < slots[best].bestCost.load())
+            best = index;
+    }
+
+    FactoryProblem::FactoryFenotype fenotype(numberOfLocations);
+    fenotype.locations = bestLocations[best];
+    return FactoryProblem::FactoryChromosome(fenotype,
+        FactoryProblem::factoryCostToFitness(static_cast<FactoryProblem::FactoryCost>(slots[best].bestCost.load())));
+}
@@ -0,0 +1,45 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef PARALLELTEMPERING_H
+#define PARALLELTEMPERING_H
+#include "factoryinstance.h"
+#include "factoryproblem.h"
+#include <functional>
+#include <thread>
+
+// Parallel tempering, one simulated annealing replica per thread at
+// geometrically spaced temperatures. Replicas walk with O(n) swap deltas and
+// between rounds neighbouring temperatures are exchanged. Only temperature
+// indexes move between replicas, so states never leave their threads.
+namespace ParallelTempering {
+struct Configuration {
+    size_t replicas = std::max(2U, std::thread::hardware_concurrency());
+    size_t movesPerRound = 1000; // Swap moves of each replica between exchanges
+    size_t maxRounds = 1000;
+    uint64_t seed = 0;
+
+    // Temperature ladder, when zero it is derived from a sample of uphill moves
+    double minTemperature = 0.0;
+    double maxTemperature = 0.0;
+
+    // Called after every round with best fitness and total number of moves,
+    // returning false stops the search
+    std::function<bool(FactoryProblem::FactoryEval, size_t)> progressFunction;
+};
+
+FactoryProblem::FactoryChromosome search(const FactoryProblem::FactoryInstance& instance, const Configuration& configuration);
+} // namespace ParallelTempering
+
+#endif // PARALLELTEMPERING_H
@@ -0,0 +1,214 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "qaplib.h"
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <random>
+
+namespace {
+// Reads n x n numbers, rejecting anything that is not a non-negative integer
+bool readMatrix(std::istream& is, Matrix<uint>& matrix) {
+    for (size_t row = 0; row < matrix.rows; row++) {
+        for (size_t col = 0; col < matrix.cols; col++) {
+            long long value = 0;
+            if (!(is >> value) || value < 0 || value > std::numeric_limits<uint>::max())
+                return false;
+            matrix[row][col] = static_cast<uint>(value);
+        }
+    }
+    return true;
+}
+
+// Mirrors upper triangle, generated instances are symmetric as in QAPLIB
+void mirror(Matrix<uint>& matrix) {
+    for (size_t row = 0; row < matrix.rows; row++) {
+        for (size_t col = 0; col < row; col++) {
+            matrix[row][col] = matrix[col][row];
+        }
+    }
+}
+
+// Characters left in the stream, -1 when it cannot seek
+std::streamoff remaining(std::istream& is) {
+    const std::streampos position = is.tellg();
+    if (position == std::streampos(-1))
+        return -1;
+    if (!is.seekg(0, std::ios::end)) {
+        is.clear();
+        return -1;
+    }
+    const std::streampos end = is.tellg();
+    is.seekg(position);
+    return end == std::streampos(-1) ? -1 : static_cast<std::streamoff>(end - position);
+}
+} // namespace
+
+std::optional<Qaplib::QaplibInstance> Qaplib::readInstance(std::istream& is) {
+    long long size = 0;
+    if (!(is >> size) || size <= 0 || static_cast<unsigned long long>(size) > MAX_SIZE)
+        return std::nullopt;
+
+    // Every number takes at least a digit and a separator
+    const std::streamoff left = remaining(is);
+    if (left >= 0 && left < 4 * size * size - 1)
+        return std::nullopt;
+
+    QaplibInstance instance(static_cast<size_t>(size));
+    if (!readMatrix(is, instance.flowMatrix) || !readMatrix(is, instance.distanceMatrix))
+        return std::nullopt;
+
+    return instance;
+}
+
+std::optional<Qaplib::QaplibInstance> Qaplib::readInstance(const std::string& path) {
+    std::ifstream file(path);
+    if (!file)
+        return std::nullopt;
+    return readInstance(file);
+}
+
+std::optional<Qaplib::QaplibSolution> Qaplib::readSolution(std::istream& is) {
+    QaplibSolution solution;
+    if (!(is >> solution.size >> solution.cost) || solution.size == 0)
+        return std::nullopt;
+
+    // Permutation is 1-based, some files separate it with commas
+    std::vector<bool> seen(solution.size, false);
+    while (solution.locations.size() < solution.size) {
+        long long location = 0;
+        if (!(is >> location)) {
+            if (is.eof())
+                return std::nullopt;
+            is.clear();
+            is.ignore(1);
+            continue;
+        }
+        if (location < 1 || static_cast<size_t>(location) > solution.size || seen[location - 1])
+            return std::nullopt;
+        seen[location - 1] = true;
+        solution.locations.push_back(static_cast<uint>(location - 1));
+    }
+    return solution;
+}
+
+void Qaplib::writeInstance(std::ostream& os, const QaplibInstance& instance) {
+    os << instance.size << "\n\n";
+    for (const Matrix<uint>* matrix : { &instance.flowMatrix, &instance.distanceMatrix }) {
+        for (size_t row = 0; row < instance.size; row++) {
+            for (size_t col = 0; col < instance.size; col++) {
+                os << " " << (*matrix)[row][col];
+            }
+            os << "\n";
+        }
+        os << "\n";
+    }
+}
+
+uint64_t Qaplib::checksum(const QaplibInstance& instance) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto add = [&hash](uint64_t value) {
+        for (size_t byte = 0; byte < sizeof(value); byte++, value >>= 8)
+            hash = (hash ^ (value & 0xFF)) * 1099511628211ULL;
+    };
+
+    add(instance.size);
+    for (const Matrix<uint>* matrix : { &instance.flowMatrix, &instance.distanceMatrix }) {
+        for (size_t row = 0; row < instance.size; row++) {
+            for (size_t col = 0; col < instance.size; col++) {
+                add((*matrix)[row][col]);
+            }
+        }
+    }
+    return hash;
+}
+
+std::optional<Qaplib::GeneratorKind> Qaplib::generatorKindFromString(const std::string& name) {
+    if (name == "uniform")
+        return GeneratorKind::UNIFORM;
+    if (name == "structured")
+        return GeneratorKind::STRUCTURED;
+    if (name == "sparse")
+        return GeneratorKind::SPARSE;
+    return std::nullopt;
+}
+
+Qaplib::QaplibInstance Qaplib::generate(GeneratorKind kind, size_t size, uint64_t seed, double flowDensity) {
+    // Own engine, generated instances do not depend on RandomService state
+    std::mt19937_64 engine(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<uint> value(0, 99);
+
+    QaplibInstance instance(size);
+    Matrix<uint>& flow = instance.flowMatrix;
+    Matrix<uint>& distance = instance.distanceMatrix;
+
+    switch (kind) {
+    case GeneratorKind::UNIFORM:
+        for (size_t row = 0; row < size; row++) {
+            for (size_t col = (row + 1); col < size; col++) {
+                flow[row][col] = value(engine);
+                distance[row][col] = value(engine);
+            }
+        }
+        break;
+
+    case GeneratorKind::STRUCTURED: {
+        // Locations are scattered around a few cluster centres in a square
+        const size_t clusters = std::max<size_t>(1, static_cast<size_t>(std::sqrt(size)));
+        std::vector<std::pair<double, double>> centres(clusters);
+        for (auto& centre : centres) {
+            centre = { unit(engine) * 1000.0, unit(engine) * 1000.0 };
+        }
+
+        std::normal_distribution<double> spread(0.0, 1000.0 / (2.0 * clusters));
+        std::vector<std::pair<double, double>> points(size);
+        for (auto& point : points) {
+            const auto& centre = centres[engine() % clusters];
+            point = { centre.first + spread(engine), centre.second + spread(engine) };
+        }
+
+        for (size_t row = 0; row < size; row++) {
+            for (size_t col = (row + 1); col < size; col++) {
+                distance[row][col] = static_cast<uint>(std::lround(
+                    std::hypot(points[row].first - points[col].first, points[row].second - points[col].second)));
+
+                // Heavy tailed flows, few large and many small
+                const double tail = std::pow(unit(engine), 4.0);
+                flow[row][col] = static_cast<uint>(tail * 10000.0);
+            }
+        }
+        break;
+    }
+
+    case GeneratorKind::SPARSE: {
+        // Locations on an almost square grid with Manhattan distances
+        const size_t width = static_cast<size_t>(std::ceil(std::sqrt(size)));
+        for (size_t row = 0; row < size; row++) {
+            for (size_t col = (row + 1); col < size; col++) {
+                const long dx = static_cast<long>(row % width) - static_cast<long>(col % width);
+                const long dy = static_cast<long>(row / width) - static_cast<long>(col / width);
+                distance[row][col] = static_cast<uint>(std::labs(dx) + std::labs(dy));
+                flow[row][col] = unit(engine) < flowDensity ? 1 + value(engine) : 0;
+            }
+        }
+        break;
+    }
+    }
+
+    mirror(flow);
+    mirror(distance);
+    return instance;
+}
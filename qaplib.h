@@ -0,0 +1,73 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef QAPLIB_H
+#define QAPLIB_H
+#include "matrix.h"
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Instances in QAPLIB layout: size, flow matrix and distance matrix as
+// whitespace separated numbers. Line breaks carry no meaning, so blank lines,
+// rows wrapped over several lines, tabs and CRLF endings are all accepted.
+namespace Qaplib {
+// Largest size read, bounds memory taken by a malformed or hostile header
+constexpr size_t MAX_SIZE = 8192;
+
+// Default share of nonzero flows in sparse instances, well below the share up
+// to which FactoryInstance uses the sparse kernels
+constexpr double DEFAULT_FLOW_DENSITY = 0.02;
+
+struct QaplibInstance {
+    explicit QaplibInstance(size_t size)
+        : size(size), flowMatrix(size, size), distanceMatrix(size, size) {
+    }
+
+    size_t size;
+    Matrix<uint> flowMatrix;
+    Matrix<uint> distanceMatrix;
+};
+
+// Solution in QAPLIB .sln layout: size, cost and 1-based permutation
+struct QaplibSolution {
+    size_t size = 0;
+    uint64_t cost = 0;
+    std::vector<uint> locations; // 0-based
+};
+
+// Sizes above MAX_SIZE, or above what the rest of a seekable stream can hold,
+// are rejected before any matrix is allocated
+std::optional<QaplibInstance> readInstance(std::istream& is);
+std::optional<QaplibInstance> readInstance(const std::string& path);
+std::optional<QaplibSolution> readSolution(std::istream& is);
+void writeInstance(std::ostream& os, const QaplibInstance& instance);
+
+// FNV-1a over size and both matrices, identifies an instance between runs
+uint64_t checksum(const QaplibInstance& instance);
+
+// Synthetic instances, same seed gives the same instance
+enum class GeneratorKind {
+    UNIFORM, // Flows and distances uniform in [0, 99] (Taillard's tai*a)
+    STRUCTURED, // Clustered points and heavy tailed flows (Taillard's tai*b)
+    SPARSE, // Grid distances and mostly zero flows
+};
+
+std::optional<GeneratorKind> generatorKindFromString(const std::string& name);
+QaplibInstance generate(GeneratorKind kind, size_t size, uint64_t seed, double flowDensity = DEFAULT_FLOW_DENSITY);
+} // namespace Qaplib
+
+#endif // QAPLIB_H
@@ -0,0 +1,395 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "racing.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+using FactoryProblem::GeneticConfiguration;
+
+const size_t MIN_POPULATION_SIZE = 10;
+const size_t MAX_POPULATION_SIZE = 1000;
+const size_t MIN_TOURNAMENT_SIZE = 2;
+
+struct Candidate {
+    GeneticConfiguration configuration;
+    std::vector<double> results; // Relative cost per block of the current race
+    bool alive = true;
+};
+
+// One run of a candidate on a block
+struct Job {
+    size_t candidate;
+    size_t block;
+    FactoryProblem::FactoryCost cost;
+    double cpuSeconds;
+};
+
+double threadCpuSeconds() {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// Inverse of the standard normal distribution function, by bisection
+double normalQuantile(double p) {
+    double low = -40.0;
+    double high = 40.0;
+    for (size_t i = 0; i < 200; i++) {
+        const double middle = (low + high) / 2.0;
+        if (0.5 * std::erfc(-middle / std::sqrt(2.0)) < p)
+            low = middle;
+        else
+            high = middle;
+    }
+    return (low + high) / 2.0;
+}
+
+// Student's t quantile, Cornish-Fisher expansion around the normal one
+double studentQuantile(double p, double degreesOfFreedom) {
+    const double z = normalQuantile(p);
+    const double z3 = z * z * z;
+    const double z5 = z3 * z * z;
+    const double v = degreesOfFreedom;
+    return z + (z3 + z) / (4.0 * v)
+        + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * v * v)
+        + (3.0 * z5 * z * z + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * v * v * v);
+}
+
+// Upper tail of the chi-square distribution, regularized incomplete gamma Q(df / 2, x / 2)
+double chiSquareSurvival(double x, double degreesOfFreedom) {
+    const double a = degreesOfFreedom / 2.0;
+    const double y = x / 2.0;
+    if (y <= 0.0)
+        return 1.0;
+
+    const double logPrefix = -y + a * std::log(y) - std::lgamma(a);
+    if (y < a + 1.0) {
+        // Series of the lower part
+        double term = 1.0 / a;
+        double sum = term;
+        for (size_t n = 1; n < 1000 && std::fabs(term) > std::fabs(sum) * 1e-15; n++) {
+            term *= y / (a + n);
+            sum += term;
+        }
+        return std::max(0.0, 1.0 - sum * std::exp(logPrefix));
+    }
+
+    // Continued fraction of the upper part (modified Lentz)
+    const double tiny = 1e-300;
+    double b = y + 1.0 - a;
+    double c = 1.0 / tiny;
+    double d = 1.0 / b;
+    double h = d;
+    for (size_t i = 1; i < 1000; i++) {
+        const double an = -static_cast<double>(i) * (i - a);
+        b += 2.0;
+        d = an * d + b;
+        d = std::fabs(d) < tiny ? tiny : d;
+        c = b + an / c;
+        c = std::fabs(c) < tiny ? tiny : c;
+        d = 1.0 / d;
+        const double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1.0) < 1e-15)
+            break;
+    }
+    return std::exp(logPrefix) * h;
+}
+
+std::vector<size_t> aliveCandidates(const std::vector<Candidate>& candidates) {
+    std::vector<size_t> alive;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (candidates[i].alive)
+            alive.push_back(i);
+    }
+    return alive;
+}
+
+// Rank sums of alive candidates over blocks of the race, ties share their average rank
+std::vector<double> rankSums(const std::vector<Candidate>& candidates, const std::vector<size_t>& alive, double& squaredRanks) {
+    std::vector<double> sums(alive.size());
+    std::vector<size_t> order(alive.size());
+    squaredRanks = 0.0;
+
+    const size_t blocks = alive.empty() ? 0 : candidates[alive.front()].results.size();
+    for (size_t block = 0; block < blocks; block++) {
+        std::iota(std::begin(order), std::end(order), 0);
+        std::sort(std::begin(order), std::end(order), [&](size_t a, size_t b) {
+            return candidates[alive[a]].results[block] < candidates[alive[b]].results[block];
+        });
+        for (size_t i = 0; i < order.size();) {
+            size_t j = i;
+            while (j < order.size() && candidates[alive[order[j]]].results[block] == candidates[alive[order[i]]].results[block])
+                j++;
+            const double averageRank = (i + 1 + j) / 2.0;
+            for (size_t k = i; k < j; k++) {
+                sums[order[k]] += averageRank;
+                squaredRanks += averageRank * averageRank;
+            }
+            i = j;
+        }
+    }
+    return sums;
+}
+
+// Drops candidates significantly worse than the best one
+void eliminate(std::vector<Candidate>& candidates, double significance) {
+    const std::vector<size_t> alive = aliveCandidates(candidates);
+    if (alive.size() < 2)
+        return;
+
+    const double b = static_cast<double>(candidates[alive.front()].results.size());
+    const double k = static_cast<double>(alive.size());
+    if (b < 2.0)
+        return;
+
+    if (alive.size() == 2) {
+        // Paired t-test of the two
+        const std::vector<double>& first = candidates[alive[0]].results;
+        const std::vector<double>& second = candidates[alive[1]].results;
+        double mean = 0.0;
+        double squares = 0.0;
+        for (size_t i = 0; i < first.size(); i++) {
+            const double difference = first[i] - second[i];
+            const double deviation = difference - mean;
+            mean += deviation / (i + 1);
+            squares += deviation * (difference - mean);
+        }
+        const double deviation = std::sqrt(squares / (b - 1.0));
+        const bool significant = deviation == 0.0
+            ? mean != 0.0
+            : std::fabs(mean) / (deviation / std::sqrt(b)) > studentQuantile(1.0 - significance / 2.0, b - 1.0);
+        if (significant)
+            candidates[alive[mean < 0.0 ? 1 : 0]].alive = false;
+        return;
+    }
+
+    // Friedman test with ties (Conover's form)
+    double squaredRanks = 0.0;
+    const std::vector<double> sums = rankSums(candidates, alive, squaredRanks);
+    const double c = b * k * (k + 1.0) * (k + 1.0) / 4.0;
+    if (squaredRanks <= c)
+        return;
+
+    double squaredSums = 0.0;
+    for (const double sum : sums)
+        squaredSums += sum * sum;
+    const double statistic = (k - 1.0) * (squaredSums - b * c) / (squaredRanks - c);
+    if (chiSquareSurvival(statistic, k - 1.0) >= significance)
+        return;
+
+    // Conover's post hoc comparison of rank sums to the best one
+    const double degreesOfFreedom = (b - 1.0) * (k - 1.0);
+    const double agreement = std::max(0.0, 1.0 - statistic / (b * (k - 1.0)));
+    const double threshold = studentQuantile(1.0 - significance / 2.0, degreesOfFreedom)
+        * std::sqrt(2.0 * b * (squaredRanks - c) / degreesOfFreedom * agreement);
+    const double best = *std::min_element(std::begin(sums), std::end(sums));
+    for (size_t i = 0; i < alive.size(); i++) {
+        if (sums[i] - best > threshold)
+            candidates[alive[i]].alive = false;
+    }
+}
+
+size_t logUniform(size_t low, size_t high, std::mt19937_64& engine) {
+    std::uniform_real_distribution<double> distribution(std::log(low), std::log(high));
+    return std::clamp(static_cast<size_t>(std::lround(std::exp(distribution(engine)))), low, high);
+}
+
+GeneticConfiguration sampleUniform(const GeneticConfiguration& initial, std::mt19937_64& engine) {
+    std::uniform_real_distribution<double> probability(0.0, 1.0);
+    GeneticConfiguration sampled = initial;
+    sampled.populationSize = logUniform(MIN_POPULATION_SIZE, MAX_POPULATION_SIZE, engine);
+    sampled.tournamentSize = logUniform(MIN_TOURNAMENT_SIZE, sampled.populationSize, engine);
+    sampled.crossingProbability = probability(engine);
+    sampled.mutatingProbability = probability(engine);
+    sampled.crossover = probability(engine) < 0.5 ? FactoryProblem::CrossoverKind::OX : FactoryProblem::CrossoverKind::SYMETRIC_OX;
+    return sampled;
+}
+
+// Sizes spread on logarithmic scale, probabilities on linear one
+GeneticConfiguration sampleAround(const GeneticConfiguration& parent, double spread, std::mt19937_64& engine) {
+    std::normal_distribution<double> normal(0.0, spread);
+    std::uniform_real_distribution<double> probability(0.0, 1.0);
+    auto scaled = [&](size_t value, size_t low, size_t high) {
+        const double logRange = std::log(static_cast<double>(MAX_POPULATION_SIZE) / MIN_POPULATION_SIZE);
+        return std::clamp(static_cast<size_t>(std::lround(value * std::exp(normal(engine) * logRange))), low, high);
+    };
+
+    GeneticConfiguration sampled = parent;
+    sampled.populationSize = scaled(parent.populationSize, MIN_POPULATION_SIZE, MAX_POPULATION_SIZE);
+    sampled.tournamentSize = scaled(parent.tournamentSize, MIN_TOURNAMENT_SIZE, sampled.populationSize);
+    sampled.crossingProbability = std::clamp(parent.crossingProbability + normal(engine), 0.0, 1.0);
+    sampled.mutatingProbability = std::clamp(parent.mutatingProbability + normal(engine), 0.0, 1.0);
+    if (probability(engine) < spread) {
+        sampled.crossover = parent.crossover == FactoryProblem::CrossoverKind::OX
+            ? FactoryProblem::CrossoverKind::SYMETRIC_OX
+            : FactoryProblem::CrossoverKind::OX;
+    }
+    return sampled;
+}
+
+double mean(const std::vector<double>& values) {
+    return values.empty() ? std::numeric_limits<double>::infinity()
+                          : std::accumulate(std::begin(values), std::end(values), 0.0) / values.size();
+}
+} // namespace
+
+std::string Racing::describe(const GeneticConfiguration& configuration) {
+    std::ostringstream os;
+    os << std::setprecision(3)
+       << "population " << configuration.populationSize
+       << ", tournament " << configuration.tournamentSize
+       << ", crossing " << configuration.crossingProbability
+       << ", mutating " << configuration.mutatingProbability
+       << ", crossover " << FactoryProblem::crossoverKindToString(configuration.crossover);
+    return os.str();
+}
+
+Racing::Result Racing::tune(const std::vector<TimeToTarget::NamedInstance>& instances,
+    const GeneticConfiguration& initial, const Configuration& configuration, std::ostream& log) {
+    Result result;
+    result.configuration = initial;
+    if (instances.empty() || configuration.iterations == 0)
+        return result;
+
+    const size_t threads = configuration.threads != 0
+        ? configuration.threads
+        : std::max<size_t>(1, std::thread::hardware_concurrency());
+    const size_t candidatesPerIteration = std::max<size_t>(2, configuration.candidatesPerIteration);
+    std::mt19937_64 engine(configuration.seed);
+
+    std::vector<Candidate> candidates(1);
+    candidates[0].configuration = initial;
+    while (candidates.size() < candidatesPerIteration)
+        candidates.push_back({ sampleUniform(initial, engine), {}, true });
+
+    uint64_t nextBlock = 0;
+    for (size_t iteration = 0; iteration < configuration.iterations && result.cpuSeconds < configuration.cpuBudget; iteration++) {
+        // Remaining budget is shared by the remaining races
+        const double raceBudget = (configuration.cpuBudget - result.cpuSeconds) / (configuration.iterations - iteration);
+        const double raceStart = result.cpuSeconds;
+        size_t blocks = 0;
+
+        std::vector<size_t> alive = aliveCandidates(candidates);
+        while (alive.size() > 1 && result.cpuSeconds - raceStart < raceBudget) {
+            // Several blocks at once keep all threads busy, but stay within the budget
+            const double stepCost = alive.size() * configuration.runSeconds;
+            const size_t affordable = static_cast<size_t>((raceBudget - (result.cpuSeconds - raceStart)) / stepCost);
+            const size_t blocksPerStep = std::max<size_t>(1, std::min((threads + alive.size() - 1) / alive.size(), affordable));
+
+            std::vector<Job> jobs;
+            for (size_t block = 0; block < blocksPerStep; block++) {
+                for (const size_t candidate : alive)
+                    jobs.push_back({ candidate, block, 0, 0.0 });
+            }
+
+            std::atomic<size_t> nextJob(0);
+            auto worker = [&]() {
+                for (size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+                    Job& job = jobs[i];
+                    const uint64_t block = nextBlock + job.block;
+                    const TimeToTarget::NamedInstance& named = instances[block % instances.size()];
+
+                    const double start = threadCpuSeconds();
+                    FactoryProblem::FactoryCost best = std::numeric_limits<FactoryProblem::FactoryCost>::max();
+                    TimeToTarget::geneticSolver(candidates[job.candidate].configuration)(*named.instance, configuration.seed + block,
+                        [&](FactoryProblem::FactoryCost cost, size_t) {
+                            best = std::min(best, cost);
+                            return threadCpuSeconds() - start < configuration.runSeconds && (named.bestKnown == 0 || best > named.bestKnown);
+                        });
+                    job.cost = best;
+                    job.cpuSeconds = threadCpuSeconds() - start;
+                }
+            };
+            std::vector<std::thread> pool;
+            for (size_t i = 1; i < std::min(threads, jobs.size()); i++)
+                pool.emplace_back(worker);
+            worker();
+            for (std::thread& thread : pool)
+                thread.join();
+
+            // Costs relative to the best of the block, or to the best known one when it is lower
+            for (size_t block = 0; block < blocksPerStep; block++) {
+                const TimeToTarget::NamedInstance& named = instances[(nextBlock + block) % instances.size()];
+                FactoryProblem::FactoryCost reference = named.bestKnown != 0 ? named.bestKnown : std::numeric_limits<FactoryProblem::FactoryCost>::max();
+                for (const Job& job : jobs) {
+                    if (job.block == block)
+                        reference = std::min(reference, job.cost);
+                }
+                for (const Job& job : jobs) {
+                    if (job.block == block) {
+                        candidates[job.candidate].results.push_back(reference == 0
+                                ? 1.0 + job.cost
+                                : static_cast<double>(job.cost) / reference);
+                    }
+                }
+            }
+            for (const Job& job : jobs)
+                result.cpuSeconds += job.cpuSeconds;
+            result.runs += jobs.size();
+            nextBlock += blocksPerStep;
+            blocks += blocksPerStep;
+
+            if (blocks >= configuration.firstTest)
+                eliminate(candidates, configuration.significance);
+            alive = aliveCandidates(candidates);
+            log << "Race " << iteration + 1 << ", blocks " << blocks << ", alive " << alive.size()
+                << ", CPU " << std::round(result.cpuSeconds * 10.0) / 10.0 << " s" << std::endl;
+        }
+
+        // Survivors ordered by rank, best first
+        double squaredRanks = 0.0;
+        const std::vector<double> sums = rankSums(candidates, alive, squaredRanks);
+        std::vector<size_t> order(alive.size());
+        std::iota(std::begin(order), std::end(order), 0);
+        std::sort(std::begin(order), std::end(order), [&](size_t a, size_t b) {
+            return sums[a] != sums[b] ? sums[a] < sums[b] : mean(candidates[alive[a]].results) < mean(candidates[alive[b]].results);
+        });
+
+        std::vector<Candidate> elites;
+        for (size_t i = 0; i < order.size() && elites.size() < std::max<size_t>(1, configuration.elites); i++) {
+            elites.push_back(candidates[alive[order[i]]]);
+        }
+        result.configuration = elites.front().configuration;
+        result.meanRelativeCost = mean(elites.front().results);
+        result.blocks = elites.front().results.size();
+        log << "Best: " << describe(result.configuration) << ", relative cost " << result.meanRelativeCost << std::endl;
+
+        // Next race: elites and candidates sampled around them, better elites are picked more often
+        const double spread = 0.3 * std::pow(0.7, static_cast<double>(iteration + 1));
+        std::vector<double> weights(elites.size());
+        for (size_t i = 0; i < elites.size(); i++)
+            weights[i] = static_cast<double>(elites.size() - i);
+        std::discrete_distribution<size_t> parent(std::begin(weights), std::end(weights));
+
+        candidates = elites;
+        for (Candidate& candidate : candidates) {
+            candidate.results.clear();
+            candidate.alive = true;
+        }
+        while (candidates.size() < candidatesPerIteration)
+            candidates.push_back({ sampleAround(elites[parent(engine)].configuration, spread, engine), {}, true });
+    }
+    return result;
+}
@@ -0,0 +1,58 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RACING_H
+#define RACING_H
+#include "factorygenetic.h"
+#include "timetotarget.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Iterated racing of genetic algorithm configurations. Every race runs all
+// candidates on the same blocks (instance and seed) in parallel and drops
+// candidates that are significantly worse by Friedman test with Conover's
+// post hoc comparison to the best, or paired t-test when two are left.
+// Survivors of a race are the elites of the next one, together with new
+// candidates sampled around them with a shrinking spread.
+namespace Racing {
+struct Configuration {
+    double cpuBudget = 600.0; // CPU seconds of all runs together
+    double runSeconds = 1.0; // CPU seconds of one run
+    size_t iterations = 4;
+    size_t candidatesPerIteration = 16;
+    size_t elites = 3;
+    size_t firstTest = 5; // Blocks before the first elimination
+    double significance = 0.05;
+    size_t threads = 0; // 0 for all hardware threads
+    uint64_t seed = 1;
+};
+
+struct Result {
+    FactoryProblem::GeneticConfiguration configuration;
+    double meanRelativeCost = 0.0; // Cost relative to the best of the block, 1 is best
+    size_t blocks = 0; // Blocks the best candidate was run on
+    size_t runs = 0;
+    double cpuSeconds = 0.0;
+};
+
+std::string describe(const FactoryProblem::GeneticConfiguration& configuration);
+
+// Initial candidate is raced together with randomly sampled ones, progress is logged
+Result tune(const std::vector<TimeToTarget::NamedInstance>& instances,
+    const FactoryProblem::GeneticConfiguration& initial,
+    const Configuration& configuration, std::ostream& log);
+} // namespace Racing
+
+#endif // RACING_H
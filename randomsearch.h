@@ -17,12 +17,21 @@
 
 #include "randomservice.h"
 #include <algorithm>
+#include <functional>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <vector>
 
 namespace RandomSearch {
 std::vector<uint> search(std::function<std::vector<uint>(void)> initializationFunction,
-    std::function<uint(const std::vector<uint>&)> evaluationFunction,
+    std::function<int64_t(const std::vector<uint>&)> evaluationFunction,
+    size_t iterationCount);
+
+// Screening function returns fitness only when it is better than threshold
+std::vector<uint> search(std::function<std::vector<uint>(void)> initializationFunction,
+    std::function<std::optional<int64_t>(const std::vector<uint>&, int64_t)> screeningFunction,
     size_t iterationCount);
 };
 
@@ -19,8 +19,9 @@
 
 class RandomService {
 public:
+    // One service per thread, so parallel runs neither share nor lock engines
     static RandomService& getService() {
-        static RandomService service;
+        thread_local RandomService service;
         return service;
     }
     RandomService(const RandomService&) = delete;
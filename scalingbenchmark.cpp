@@ -0,0 +1,96 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "scalingbenchmark.h"
+#include "bulkrandom.h"
+#include "factoryinstance.h"
+#include "factorykernels.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+namespace {
+// Runs function for at least minimal time, returns calls per second
+template <class Function>
+double throughput(Function function) {
+    using Clock = std::chrono::steady_clock;
+    const auto minimalTime = std::chrono::milliseconds(200);
+
+    size_t calls = 0;
+    const auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do {
+        for (size_t i = 0; i < 16; i++, calls++) {
+            function();
+        }
+        elapsed = Clock::now() - start;
+    } while (elapsed < minimalTime);
+
+    return calls / std::chrono::duration<double>(elapsed).count();
+}
+
+// Reference kernels storing both full matrices, element type as selected
+std::unique_ptr<FactoryProblem::FactoryKernels> denseKernels(const Qaplib::QaplibInstance& generated, size_t elementSize) {
+    using namespace FactoryProblem;
+    if (elementSize == sizeof(uint8_t))
+        return std::make_unique<DenseFactoryKernels<uint8_t>>(generated.distanceMatrix, generated.flowMatrix);
+    if (elementSize == sizeof(uint16_t))
+        return std::make_unique<DenseFactoryKernels<uint16_t>>(generated.distanceMatrix, generated.flowMatrix);
+    return std::make_unique<DenseFactoryKernels<uint32_t>>(generated.distanceMatrix, generated.flowMatrix);
+}
+
+struct Throughput {
+    double evaluations;
+    double deltas;
+};
+
+// Results are summed so the calls are not optimised away
+Throughput measure(const FactoryProblem::FactoryKernels& kernels, const std::vector<uint>& locations, const std::vector<uint>& positions, BulkRandom& random) {
+    volatile uint64_t sink = 0;
+    const uint32_t range = static_cast<uint32_t>(locations.size());
+    const double evaluations = throughput([&]() { sink = sink + kernels.cost(locations); });
+    const double deltas = throughput([&]() {
+        sink = sink + static_cast<uint64_t>(kernels.indexedSwapDelta(locations, positions, random.nextBelow(range), random.nextBelow(range)));
+    });
+    return { evaluations, deltas };
+}
+} // namespace
+
+void ScalingBenchmark::run(std::ostream& os, Qaplib::GeneratorKind kind, uint64_t seed, const std::vector<size_t>& sizes) {
+    os << "n,elementBytes,symmetric,sparse,matrixBytes,evaluationsPerSecond,swapDeltasPerSecond,"
+          "denseMatrixBytes,denseEvaluationsPerSecond,denseSwapDeltasPerSecond\n";
+
+    BulkRandom random(seed);
+    for (const size_t size : sizes) {
+        const Qaplib::QaplibInstance generated = Qaplib::generate(kind, size, seed);
+        const FactoryProblem::FactoryInstance instance(generated.distanceMatrix, generated.flowMatrix);
+        const FactoryProblem::FactoryKernels& kernels = instance.kernels();
+
+        std::vector<uint> locations(size);
+        std::iota(std::begin(locations), std::end(locations), 0U);
+        std::shuffle(std::begin(locations), std::end(locations), std::mt19937_64(seed));
+        std::vector<uint> positions(size);
+        for (size_t i = 0; i < size; i++) {
+            positions[locations[i]] = static_cast<uint>(i);
+        }
+
+        const Throughput selected = measure(kernels, locations, positions, random);
+        const std::unique_ptr<FactoryProblem::FactoryKernels> dense = denseKernels(generated, instance.elementSize());
+        const Throughput reference = measure(*dense, locations, positions, random);
+
+        os << size << "," << instance.elementSize() << "," << instance.isSymmetric() << "," << instance.isSparse() << ","
+           << kernels.bytes() << "," << selected.evaluations << "," << selected.deltas << ","
+           << dense->bytes() << "," << reference.evaluations << "," << reference.deltas << std::endl;
+    }
+}
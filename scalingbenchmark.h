@@ -0,0 +1,27 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef SCALINGBENCHMARK_H
+#define SCALINGBENCHMARK_H
+#include "qaplib.h"
+#include <iostream>
+#include <vector>
+
+// Throughput and memory of evaluation kernels against instance size, one CSV
+// row per size
+namespace ScalingBenchmark {
+void run(std::ostream& os, Qaplib::GeneratorKind kind, uint64_t seed, const std::vector<size_t>& sizes);
+}
+
+#endif // SCALINGBENCHMARK_H
@@ -0,0 +1,43 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+#include <array>
+#include <vector>
+
+// Per thread buffers reused by operators between calls. Buffers keep their
+// capacity, so after the first generation taking one does not allocate.
+template <class T>
+class ScratchArena {
+public:
+    static constexpr size_t SLOTS = 4;
+
+    static ScratchArena& local() {
+        thread_local ScratchArena arena;
+        return arena;
+    }
+
+    // Cleared buffer, slots let one operator hold a few buffers at once
+    std::vector<T>& buffer(size_t slot) {
+        buffers[slot].clear();
+        return buffers[slot];
+    }
+
+private:
+    ScratchArena() = default;
+    std::array<std::vector<T>, SLOTS> buffers;
+};
+
+#endif // SCRATCHARENA_H
@@ -0,0 +1,544 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "solverdaemon.h"
+#include "qaplib.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using InstancePointer = std::shared_ptr<const FactoryProblem::FactoryInstance>;
+
+// Instances by checksum, least recently used one is dropped first. Paths
+// remember checksums of files, so unchanged files are not parsed again, and
+// are dropped with the instance. Files are parsed outside of the lock, running
+// solves keep evicted instances alive through shared pointers.
+class InstanceCache {
+public:
+    explicit InstanceCache(size_t capacity)
+        : capacity(std::max<size_t>(1, capacity)) {
+    }
+
+    InstancePointer get(const std::string& path) {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0)
+            return nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto known = paths.find(path);
+            if (known != std::end(paths) && known->second.modified == status.st_mtime && known->second.bytes == status.st_size) {
+                hits++;
+                return use(instances.at(known->second.checksum));
+            }
+            misses++;
+        }
+
+        const std::optional<Qaplib::QaplibInstance> read = Qaplib::readInstance(path);
+        if (!read)
+            return nullptr;
+        const uint64_t checksum = Qaplib::checksum(*read);
+        InstancePointer instance = std::make_shared<const FactoryProblem::FactoryInstance>(read->distanceMatrix, read->flowMatrix);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        // Same content may have been loaded meanwhile or under another path
+        auto cached = instances.find(checksum);
+        if (cached == std::end(instances)) {
+            if (instances.size() >= capacity)
+                evict();
+            order.push_front(checksum);
+            cached = instances.emplace(checksum, CachedInstance{ std::move(instance), std::begin(order), {} }).first;
+        }
+        const auto known = paths.find(path);
+        if (known == std::end(paths) || known->second.checksum != checksum)
+            cached->second.paths.push_back(path);
+        paths[path] = { status.st_mtime, status.st_size, checksum };
+        return use(cached->second);
+    }
+
+    std::string stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream os;
+        os << "cached " << instances.size() << " paths " << paths.size() << " hits " << hits << " misses " << misses;
+        return os.str();
+    }
+
+private:
+    struct CachedInstance {
+        InstancePointer instance;
+        std::list<uint64_t>::iterator position;
+        std::vector<std::string> paths; // Paths last seen with this content
+    };
+
+    struct PathEntry {
+        time_t modified;
+        off_t bytes;
+        uint64_t checksum;
+    };
+
+    InstancePointer use(CachedInstance& cached) {
+        order.splice(std::begin(order), order, cached.position);
+        return cached.instance;
+    }
+
+    void evict() {
+        const auto evicted = instances.find(order.back());
+        for (const std::string& path : evicted->second.paths) {
+            const auto known = paths.find(path);
+            if (known != std::end(paths) && known->second.checksum == evicted->first)
+                paths.erase(known);
+        }
+        instances.erase(evicted);
+        order.pop_back();
+    }
+
+    const size_t capacity;
+    std::mutex mutex;
+    std::list<uint64_t> order; // Most recently used first
+    std::unordered_map<uint64_t, CachedInstance> instances;
+    std::map<std::string, PathEntry> paths; // Only paths of cached instances
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+// One solve, worker posts messages and the connection sends them
+struct Job {
+    InstancePointer instance;
+    const TimeToTarget::Solver* solver = nullptr;
+    double seconds = 0.0; // Counted from the request, time in the queue included
+    Clock::time_point submitted = Clock::now();
+    uint64_t seed = 0;
+    std::atomic<bool> cancelled{ false };
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::string> messages;
+    bool finished = false;
+
+    void post(std::string message, bool last = false) {
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.push_back(std::move(message));
+        finished = finished || last;
+        changed.notify_all();
+    }
+};
+
+class WorkerPool {
+public:
+    WorkerPool(size_t workers, const std::atomic<bool>& stopping)
+        : stopping(stopping) {
+        for (size_t i = 0; i < workers; i++)
+            threads.emplace_back([this]() { work(); });
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        available.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    size_t size() const { return threads.size(); }
+
+    void submit(std::shared_ptr<Job> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(job));
+        }
+        available.notify_one();
+    }
+
+    std::string stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream os;
+        os << "workers " << threads.size() << " queued " << queue.size() << " running " << running << " solved " << solved;
+        return os.str();
+    }
+
+private:
+    void work() {
+        for (;;) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this]() { return closed || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                job = std::move(queue.front());
+                queue.pop_front();
+                running++;
+            }
+            run(*job);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running--;
+                solved++;
+            }
+        }
+    }
+
+    void run(Job& job) {
+        if (stopping.load()) {
+            job.post("error shutting down", true);
+            return;
+        }
+
+        auto elapsed = [&job]() { return std::chrono::duration<double>(Clock::now() - job.submitted).count(); };
+        std::ostringstream started;
+        started << "started " << elapsed();
+        job.post(started.str());
+
+        // Failed run ends its request, the worker goes on with the next one
+        FactoryProblem::FactoryCost best = std::numeric_limits<FactoryProblem::FactoryCost>::max();
+        std::optional<FactoryProblem::FactoryChromosome> result;
+        try {
+            result = (*job.solver)(*job.instance, job.seed,
+                [&](FactoryProblem::FactoryCost cost, size_t) {
+                    if (cost < best) {
+                        best = cost;
+                        std::ostringstream os;
+                        os << "progress " << cost << " " << elapsed();
+                        job.post(os.str());
+                    }
+                    return elapsed() < job.seconds && !job.cancelled.load() && !stopping.load();
+                });
+        } catch (const std::exception& exception) {
+            job.post(std::string("error solver failed: ") + exception.what(), true);
+            return;
+        }
+        const FactoryProblem::FactoryChromosome& found = *result;
+
+        std::ostringstream os;
+        os << "done " << job.instance->kernels().cost(found.fenotype.locations) << " " << elapsed() << " "
+           << (job.cancelled.load() || stopping.load() ? "cancelled" : "completed");
+        for (const uint location : found.fenotype.locations)
+            os << " " << location;
+        job.post(os.str(), true);
+    }
+
+    const std::atomic<bool>& stopping;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<std::shared_ptr<Job>> queue;
+    std::vector<std::thread> threads;
+    bool closed = false;
+    size_t running = 0;
+    size_t solved = 0;
+};
+
+bool sendLine(int descriptor, const std::string& line) {
+    const std::string data = line + "\n";
+    for (size_t sent = 0; sent < data.size();) {
+        const ssize_t written = send(descriptor, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0)
+            return false;
+        sent += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Lines of a connection, reading never waits longer than the given timeout
+class LineReader {
+public:
+    enum class Status {
+        LINE,
+        PENDING, // No whole line yet
+        CLOSED, // End of stream, error or overlong line
+    };
+
+    explicit LineReader(int descriptor)
+        : descriptor(descriptor) {
+    }
+
+    // Negative timeout waits for a line or the end of stream
+    Status next(std::string& line, int timeoutMilliseconds) {
+        for (;;) {
+            const size_t end = buffer.find('\n');
+            if (end != std::string::npos) {
+                line.assign(buffer, 0, end);
+                buffer.erase(0, end + 1);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                return Status::LINE;
+            }
+            if (buffer.size() > MAX_LINE)
+                return Status::CLOSED;
+
+            pollfd readable = { descriptor, POLLIN, 0 };
+            const int ready = poll(&readable, 1, timeoutMilliseconds);
+            if (ready == 0 || (ready < 0 && errno == EINTR))
+                return Status::PENDING;
+            char chunk[1024];
+            const ssize_t received = ready < 0 ? -1 : recv(descriptor, chunk, sizeof(chunk), 0);
+            if (received <= 0)
+                return Status::CLOSED;
+            buffer.append(chunk, static_cast<size_t>(received));
+            timeoutMilliseconds = 0; // Rest of a partial line is asked for again
+        }
+    }
+
+private:
+    static constexpr size_t MAX_LINE = 4096;
+
+    const int descriptor;
+    std::string buffer;
+};
+
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+struct Daemon {
+    const std::vector<TimeToTarget::NamedSolver>& solvers;
+    std::ostream& log;
+    std::mutex logMutex;
+    std::atomic<bool> stopping{ false };
+    std::atomic<uint64_t> nextSeed{ 1 };
+    InstanceCache cache;
+    WorkerPool pool;
+
+    Daemon(const SolverDaemon::Configuration& configuration, const std::vector<TimeToTarget::NamedSolver>& solvers, std::ostream& log)
+        : solvers(solvers), log(log), cache(configuration.cacheCapacity),
+          pool(configuration.workers != 0 ? configuration.workers : std::max<size_t>(1, std::thread::hardware_concurrency()), stopping) {
+    }
+
+    // Request that fails, e.g. running out of memory on a huge instance, is
+    // answered with an error instead of terminating the daemon
+    void handle(int connection) {
+        try {
+            serveRequest(connection);
+        } catch (const std::exception& exception) {
+            sendLine(connection, std::string("error ") + exception.what());
+        }
+    }
+
+    void serveRequest(int connection) {
+        // Idle connection does not hold the daemon after shutdown
+        LineReader reader(connection);
+        std::string line;
+        LineReader::Status status = LineReader::Status::PENDING;
+        while (status == LineReader::Status::PENDING && !stopping.load())
+            status = reader.next(line, 100);
+        if (status != LineReader::Status::LINE)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            log << line << std::endl;
+        }
+
+        std::istringstream words(line);
+        std::string command;
+        words >> command;
+        if (command == "stats") {
+            sendLine(connection, "stats " + cache.stats() + " " + pool.stats());
+        } else if (command == "shutdown") {
+            stopping.store(true);
+            sendLine(connection, "ok");
+        } else if (command == "solve") {
+            solve(connection, words, reader);
+        } else {
+            sendLine(connection, "error unknown request");
+        }
+    }
+
+    void solve(int connection, std::istringstream& words, LineReader& reader) {
+        std::string path;
+        double seconds = 0.0;
+        std::string solverName;
+        if (!(words >> path >> seconds) || seconds <= 0.0) {
+            sendLine(connection, "error usage: solve <instance.dat> <seconds> [solver]");
+            return;
+        }
+        words >> solverName;
+
+        const auto named = std::find_if(std::begin(solvers), std::end(solvers),
+            [&solverName](const TimeToTarget::NamedSolver& solver) { return solverName.empty() || solver.name == solverName; });
+        if (named == std::end(solvers)) {
+            sendLine(connection, "error unknown solver " + solverName);
+            return;
+        }
+
+        auto job = std::make_shared<Job>();
+        job->submitted = Clock::now();
+        job->instance = cache.get(path);
+        if (!job->instance) {
+            sendLine(connection, "error cannot load " + path);
+            return;
+        }
+        job->solver = &named->solver;
+        job->seconds = seconds;
+        job->seed = nextSeed++;
+        pool.submit(job);
+
+        bool finished = false;
+        std::deque<std::string> messages;
+        while (!finished) {
+            {
+                std::unique_lock<std::mutex> lock(job->mutex);
+                job->changed.wait_for(lock, std::chrono::milliseconds(50),
+                    [&job]() { return job->finished || !job->messages.empty(); });
+                std::swap(messages, job->messages);
+                finished = job->finished;
+            }
+            for (const std::string& message : messages) {
+                if (!sendLine(connection, message))
+                    job->cancelled.store(true);
+            }
+            messages.clear();
+
+            // Cancel request or closed connection stop the run
+            std::string line;
+            LineReader::Status status = LineReader::Status::LINE;
+            while (!job->cancelled.load() && status == LineReader::Status::LINE) {
+                status = reader.next(line, 0);
+                if (status == LineReader::Status::CLOSED || (status == LineReader::Status::LINE && line == "cancel"))
+                    job->cancelled.store(true);
+            }
+        }
+    }
+};
+} // namespace
+
+bool SolverDaemon::serve(const Configuration& configuration, const std::vector<TimeToTarget::NamedSolver>& solvers, std::ostream& log) {
+    if (solvers.empty() || configuration.socketPath.size() >= sizeof(sockaddr_un::sun_path))
+        return false;
+
+    // Socket of a running daemon is never taken over, only one left by a
+    // daemon that did not exit cleanly is removed. Other files are kept.
+    const sockaddr_un address = socketAddress(configuration.socketPath);
+    struct stat existing;
+    if (lstat(configuration.socketPath.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            log << configuration.socketPath << " exists and is not a socket" << std::endl;
+            return false;
+        }
+
+        const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe < 0)
+            return false;
+        const bool running = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        const bool stale = !running && errno == ECONNREFUSED;
+        close(probe);
+        if (running) {
+            log << "Socket " << configuration.socketPath << " is served by a running daemon" << std::endl;
+            return false;
+        }
+        if (stale)
+            unlink(configuration.socketPath.c_str());
+    }
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return false;
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        close(listener);
+        return false;
+    }
+
+    Daemon daemon(configuration, solvers, log);
+    log << "Listening on " << configuration.socketPath << " with " << daemon.pool.size() << " workers" << std::endl;
+
+    std::atomic<size_t> connections{ 0 };
+    while (!daemon.stopping.load()) {
+        pollfd incoming = { listener, POLLIN, 0 };
+        if (poll(&incoming, 1, 100) <= 0)
+            continue;
+
+        const int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0)
+            continue;
+
+        // Client that stops reading fails the send instead of blocking it
+        const timeval sendTimeout = { 1, 0 };
+        setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+
+        connections++;
+        std::thread([&daemon, &connections, connection]() {
+            daemon.handle(connection);
+            close(connection);
+            connections--;
+        }).detach();
+    }
+
+    close(listener);
+    unlink(configuration.socketPath.c_str());
+
+    // Running solves see the stop flag, connections end with them
+    while (connections.load() != 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return true;
+}
+
+bool SolverDaemon::request(const std::string& socketPath, const std::string& line, std::ostream& os, double cancelAfter) {
+    if (socketPath.size() >= sizeof(sockaddr_un::sun_path))
+        return false;
+
+    const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0)
+        return false;
+
+    const sockaddr_un address = socketAddress(socketPath);
+    if (connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || !sendLine(connection, line)) {
+        close(connection);
+        return false;
+    }
+
+    const Clock::time_point start = Clock::now();
+    bool cancelled = cancelAfter <= 0.0;
+    LineReader reader(connection);
+    for (;;) {
+        std::string received;
+        const LineReader::Status status = reader.next(received, cancelled ? -1 : 10);
+        if (status == LineReader::Status::CLOSED)
+            break;
+        if (status == LineReader::Status::LINE)
+            os << received << std::endl;
+        if (!cancelled && std::chrono::duration<double>(Clock::now() - start).count() >= cancelAfter) {
+            cancelled = true;
+            sendLine(connection, "cancel");
+        }
+    }
+
+    close(connection);
+    return true;
+}
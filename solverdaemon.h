@@ -0,0 +1,54 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef SOLVERDAEMON_H
+#define SOLVERDAEMON_H
+#include "timetotarget.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Solver serving requests on a local Unix socket, one request line per
+// connection:
+//   solve <instance.dat> <seconds> [solver]  sends "started <seconds>" when a
+//                                            worker takes the run, streams
+//                                            "progress <cost> <seconds>" lines
+//                                            and ends with "done <cost>
+//                                            <seconds> <completed|cancelled>
+//                                            <locations...>"; "cancel" sent on
+//                                            the connection or closing it stops
+//                                            the run
+// All seconds count from the request, time waiting for a worker included.
+//   stats                                    cache and pool counters
+//   shutdown                                 stops running solves and the daemon
+// Parsed instances stay in an LRU cache keyed by checksum, runs go to a pool
+// of worker threads started once.
+namespace SolverDaemon {
+struct Configuration {
+    std::string socketPath;
+    size_t workers = 0; // 0 for all hardware threads
+    size_t cacheCapacity = 8; // Instances
+};
+
+// Serves until a shutdown request, false when the socket cannot be opened or
+// another daemon still serves it.
+// First solver is used by requests naming none.
+bool serve(const Configuration& configuration, const std::vector<TimeToTarget::NamedSolver>& solvers, std::ostream& log);
+
+// Sends the request and copies response lines to os until the daemon closes
+// the connection, cancels a solve after cancelAfter seconds when positive
+bool request(const std::string& socketPath, const std::string& line, std::ostream& os, double cancelAfter = 0.0);
+} // namespace SolverDaemon
+
+#endif // SOLVERDAEMON_H
@@ -0,0 +1,161 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "telemetry.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Telemetry {
+struct Segment {
+    static constexpr uint32_t MAGIC = 0x47414C54; // "GALT"
+
+    uint32_t magic;
+    uint32_t capacity;
+    pid_t writer;
+    std::atomic<uint64_t> sequence; // Odd while the writer updates
+    Snapshot snapshot;
+    uint32_t genes[1]; // Capacity genes follow
+};
+} // namespace Telemetry
+
+namespace {
+std::string objectName(const std::string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+size_t segmentBytes(size_t capacity) {
+    return offsetof(Telemetry::Segment, genes) + std::max<size_t>(1, capacity) * sizeof(uint32_t);
+}
+
+// Segment set up by a writer that is no longer running. One without the
+// magic yet may be in the middle of another writer's setup, so it is kept.
+bool isStale(const std::string& name) {
+    const int descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+    if (descriptor < 0)
+        return errno == ENOENT;
+
+    struct stat status;
+    bool stale = false;
+    if (fstat(descriptor, &status) == 0 && static_cast<size_t>(status.st_size) >= segmentBytes(0)) {
+        void* mapped = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (mapped != MAP_FAILED) {
+            const Telemetry::Segment* segment = static_cast<const Telemetry::Segment*>(mapped);
+            stale = segment->magic == Telemetry::Segment::MAGIC && kill(segment->writer, 0) != 0 && errno == ESRCH;
+            munmap(mapped, status.st_size);
+        }
+    }
+    close(descriptor);
+    return stale;
+}
+} // namespace
+
+Telemetry::Publisher::Publisher(const std::string& name, size_t capacity)
+    : name(objectName(name)), bytes(segmentBytes(capacity)) {
+    // Segment of another running solver is never taken over
+    int descriptor = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (descriptor < 0 && errno == EEXIST && isStale(this->name)) {
+        shm_unlink(this->name.c_str());
+        descriptor = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (descriptor < 0)
+        return;
+
+    if (ftruncate(descriptor, static_cast<off_t>(bytes)) == 0) {
+        void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        if (mapped != MAP_FAILED) {
+            segment = static_cast<Segment*>(mapped);
+            segment->capacity = static_cast<uint32_t>(capacity);
+            segment->writer = getpid();
+            segment->sequence.store(0, std::memory_order_relaxed);
+            segment->snapshot = Snapshot();
+            std::atomic_thread_fence(std::memory_order_release);
+            segment->magic = Segment::MAGIC;
+        }
+    }
+    close(descriptor);
+    if (segment == nullptr)
+        shm_unlink(this->name.c_str());
+}
+
+Telemetry::Publisher::~Publisher() {
+    if (segment != nullptr) {
+        munmap(segment, bytes);
+        shm_unlink(name.c_str());
+    }
+}
+
+void Telemetry::Publisher::publish(const Snapshot& snapshot, const uint32_t* genes, size_t numberOfGenes) {
+    if (segment == nullptr)
+        return;
+
+    numberOfGenes = std::min<size_t>(numberOfGenes, segment->capacity);
+
+    const uint64_t sequence = segment->sequence.load(std::memory_order_relaxed);
+    segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    segment->snapshot = snapshot;
+    segment->snapshot.numberOfGenes = numberOfGenes;
+    std::memcpy(segment->genes, genes, numberOfGenes * sizeof(uint32_t));
+
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool Telemetry::read(const std::string& name, Snapshot& snapshot, std::vector<uint32_t>& genes) {
+    const int descriptor = shm_open(objectName(name).c_str(), O_RDONLY, 0);
+    if (descriptor < 0)
+        return false;
+
+    struct stat status;
+    void* mapped = MAP_FAILED;
+    if (fstat(descriptor, &status) == 0 && static_cast<size_t>(status.st_size) >= segmentBytes(0))
+        mapped = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    const Segment* segment = static_cast<const Segment*>(mapped);
+    bool consistent = false;
+    if (segment->magic == Segment::MAGIC && segmentBytes(segment->capacity) <= static_cast<size_t>(status.st_size)) {
+        genes.resize(segment->capacity);
+        // Writer that died in the middle of an update leaves the sequence odd
+        for (size_t attempt = 0; attempt < READ_ATTEMPTS && !consistent; attempt++) {
+            const uint64_t before = segment->sequence.load(std::memory_order_acquire);
+            if (before % 2 == 1) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            snapshot = segment->snapshot;
+            const size_t numberOfGenes = std::min<size_t>(snapshot.numberOfGenes, segment->capacity);
+            std::memcpy(genes.data(), segment->genes, numberOfGenes * sizeof(uint32_t));
+            genes.resize(numberOfGenes);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            consistent = segment->sequence.load(std::memory_order_relaxed) == before;
+            if (!consistent)
+                genes.resize(segment->capacity);
+        }
+    }
+
+    munmap(mapped, status.st_size);
+    return consistent;
+}
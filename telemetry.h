@@ -0,0 +1,110 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include "geneticalgorithm.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Live state of a run published in a POSIX shared memory segment. Writer
+// never blocks nor does I/O, readers copy the state under a seqlock and retry
+// when the writer was in the middle of an update.
+namespace Telemetry {
+struct Snapshot {
+    uint64_t generation = 0;
+    uint64_t populationSize = 0;
+    double bestResult = 0.0;
+    double meanResult = 0.0;
+    double evaluationsPerSecond = 0.0;
+    double selectionSeconds = 0.0;
+    double crossoverSeconds = 0.0;
+    double mutationSeconds = 0.0;
+    double evaluationSeconds = 0.0;
+    uint64_t numberOfGenes = 0;
+};
+
+struct Segment;
+
+class Publisher {
+public:
+    // Name is a shared memory object name, capacity is the most genes
+    // published. Not open when a running writer already uses the name or
+    // is still setting up its segment.
+    Publisher(const std::string& name, size_t capacity);
+    ~Publisher();
+    Publisher(const Publisher&) = delete;
+    void operator=(const Publisher&) = delete;
+
+    bool isOpen() const { return segment != nullptr; }
+    void publish(const Snapshot& snapshot, const uint32_t* genes, size_t numberOfGenes);
+
+private:
+    std::string name;
+    size_t bytes = 0;
+    Segment* segment = nullptr;
+};
+
+// Consistent copy of the segment, false when it does not exist or no
+// consistent copy was made in READ_ATTEMPTS attempts
+constexpr size_t READ_ATTEMPTS = 10000;
+bool read(const std::string& name, Snapshot& snapshot, std::vector<uint32_t>& genes);
+
+// Logging function publishing every generation
+template <class Fenotype, class Eval>
+struct TelemetryLoggingFunction : public LoggingFunction<Fenotype, Eval> {
+    using Population = std::vector<Chromosome<Fenotype, Eval>>;
+    using Clock = std::chrono::steady_clock;
+
+    TelemetryLoggingFunction(const std::string& name, size_t capacity,
+        std::function<long(Eval)> fitnessToResult,
+        std::function<const std::vector<uint>&(const Fenotype&)> genesFunction)
+        : publisher(name, capacity), fitnessToResult(fitnessToResult), genesFunction(genesFunction) {
+    }
+
+    Publisher publisher;
+    std::function<long(Eval)> fitnessToResult;
+    std::function<const std::vector<uint>&(const Fenotype&)> genesFunction;
+
+    Snapshot snapshot;
+    Clock::time_point lastPublished = Clock::now();
+
+    void operator()(const Population& population, const PopulationStatistics<Eval>& statistics) override {
+        const Clock::time_point now = Clock::now();
+        const double elapsed = std::chrono::duration<double>(now - lastPublished).count();
+        lastPublished = now;
+
+        snapshot.populationSize = population.size();
+        snapshot.bestResult = static_cast<double>(fitnessToResult(statistics.max));
+        snapshot.meanResult = static_cast<double>(fitnessToResult(static_cast<Eval>(statistics.mean)));
+        snapshot.evaluationsPerSecond = elapsed > 0.0 ? population.size() / elapsed : 0.0;
+        snapshot.selectionSeconds = statistics.selectionSeconds;
+        snapshot.crossoverSeconds = statistics.crossoverSeconds;
+        snapshot.mutationSeconds = statistics.mutationSeconds;
+        snapshot.evaluationSeconds = statistics.evaluationSeconds;
+
+        const std::vector<uint>& genes = genesFunction(population[statistics.bestIndex].fenotype);
+        publisher.publish(snapshot, genes.data(), genes.size());
+        snapshot.generation++;
+    }
+
+    void show() const override {}
+};
+} // namespace Telemetry
+
+#endif // TELEMETRY_H
@@ -0,0 +1,312 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "timetotarget.h"
+#include "bulkrandom.h"
+#include "generics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+namespace {
+struct TracePoint {
+    double seconds;
+    size_t evaluations;
+    FactoryProblem::FactoryCost cost;
+};
+
+// Value at quantile of sorted values, nearest rank
+double quantile(const std::vector<double>& sorted, double q) {
+    if (sorted.empty())
+        return std::numeric_limits<double>::quiet_NaN();
+    const size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+struct MannWhitney {
+    double pValue = 1.0;
+    bool firstSmaller = false;
+};
+
+// Two sided Mann-Whitney U test, normal approximation with tie correction.
+// Infinite values stand for runs that did not reach the target.
+MannWhitney mannWhitney(const std::vector<double>& first, const std::vector<double>& second) {
+    const size_t n1 = first.size();
+    const size_t n2 = second.size();
+    if (n1 == 0 || n2 == 0)
+        return MannWhitney();
+
+    std::vector<std::pair<double, bool>> pooled;
+    for (const double value : first) {
+        pooled.emplace_back(value, true);
+    }
+    for (const double value : second) {
+        pooled.emplace_back(value, false);
+    }
+    std::sort(std::begin(pooled), std::end(pooled));
+
+    const double n = static_cast<double>(n1 + n2);
+    double rankSum = 0.0;
+    double tieCorrection = 0.0;
+    for (size_t i = 0; i < pooled.size();) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first) {
+            j++;
+        }
+        const double averageRank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; k++) {
+            if (pooled[k].second)
+                rankSum += averageRank;
+        }
+        const double ties = static_cast<double>(j - i);
+        tieCorrection += ties * ties * ties - ties;
+        i = j;
+    }
+
+    const double u = rankSum - n1 * (n1 + 1) / 2.0;
+    const double mean = n1 * n2 / 2.0;
+    const double variance = n1 * n2 / 12.0 * ((n + 1) - tieCorrection / (n * (n - 1)));
+    if (variance <= 0.0)
+        return MannWhitney();
+
+    MannWhitney result;
+    const double z = std::max(0.0, std::fabs(u - mean) - 0.5) / std::sqrt(variance);
+    result.pValue = std::erfc(z / std::sqrt(2.0));
+    result.firstSmaller = u < mean;
+    return result;
+}
+
+// CSV field, quoted when it holds a separator, quote or line break
+std::string csvField(const std::string& text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos)
+        return text;
+    std::string quoted = "\"";
+    for (const char character : text) {
+        quoted += character;
+        if (character == '"')
+            quoted += '"';
+    }
+    return quoted + "\"";
+}
+
+// Fields of a CSV line, false on an unterminated quote
+bool csvFields(const std::string& line, std::vector<std::string>& fields) {
+    fields.assign(1, std::string());
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); i++) {
+        const char character = line[i];
+        if (quoted && character == '"' && (i + 1) < line.size() && line[i + 1] == '"')
+            fields.back() += line[++i];
+        else if (character == '"')
+            quoted = !quoted;
+        else if (!quoted && character == ',')
+            fields.emplace_back();
+        else if (quoted || character != '\r')
+            fields.back() += character;
+    }
+    return !quoted;
+}
+
+template <class Value>
+bool parseField(const std::string& field, Value& value) {
+    std::istringstream is(field);
+    return (is >> value) && (is >> std::ws).eof();
+}
+
+void seedThread(uint64_t seed) {
+    RandomService::getService().getEngine().seed(seed);
+    BulkRandom::local().seed(seed);
+}
+} // namespace
+
+TimeToTarget::Solver TimeToTarget::geneticSolver(const FactoryProblem::GeneticConfiguration& configuration) {
+    return [configuration](const FactoryProblem::FactoryInstance& instance, uint64_t seed, const Observer& observer) {
+        using Fenotype = FactoryProblem::FactoryFenotype;
+        using Eval = FactoryProblem::FactoryEval;
+        seedThread(seed);
+
+        size_t evaluations = 0;
+        // Adaptive runs change population size between generations
+        GenericCallbackStopCondition<Fenotype, Eval> stopCondition([&](const std::vector<Chromosome<Fenotype, Eval>>& population,
+                                                                       const PopulationStatistics<Eval>& statistics) {
+            evaluations += population.size();
+            return !observer(FactoryProblem::factoryFitnessToResult(statistics.max), evaluations);
+        });
+        GenericNoLoggingFunction<Fenotype, Eval> loggingFunction;
+
+        return FactoryProblem::runGeneticAlgorithm(instance, configuration, stopCondition, loggingFunction);
+    };
+}
+
+TimeToTarget::Solver TimeToTarget::temperingSolver(const ParallelTempering::Configuration& configuration) {
+    // Every swap delta counts as one evaluation
+    return [configuration](const FactoryProblem::FactoryInstance& instance, uint64_t seed, const Observer& observer) {
+        ParallelTempering::Configuration seeded = configuration;
+        seeded.seed = seed;
+        seeded.maxRounds = std::numeric_limits<size_t>::max();
+        seeded.progressFunction = [&](FactoryProblem::FactoryEval fitness, size_t moves) {
+            return observer(FactoryProblem::factoryFitnessToResult(fitness), moves);
+        };
+        return ParallelTempering::search(instance, seeded);
+    };
+}
+
+std::vector<TimeToTarget::Record> TimeToTarget::run(const std::vector<NamedSolver>& solvers,
+    const std::vector<NamedInstance>& instances, const Configuration& configuration) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<Record> records;
+
+    for (const NamedInstance& named : instances) {
+        // Traces are kept until all runs on the instance are done, targets
+        // of instances without best known cost depend on the best found
+        std::vector<std::tuple<const NamedSolver*, uint64_t, std::vector<TracePoint>>> traces;
+        FactoryProblem::FactoryCost bestFound = std::numeric_limits<FactoryProblem::FactoryCost>::max();
+
+        for (const NamedSolver& solver : solvers) {
+            for (uint64_t seed = 1; seed <= configuration.runs; seed++) {
+                std::vector<TracePoint> trace;
+                const auto start = Clock::now();
+
+                solver.solver(*named.instance, seed, [&](FactoryProblem::FactoryCost cost, size_t evaluations) {
+                    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                    if (trace.empty() || cost < trace.back().cost)
+                        trace.push_back({ seconds, evaluations, cost });
+                    return seconds < configuration.timeLimit && (named.bestKnown == 0 || cost > named.bestKnown);
+                });
+
+                if (!trace.empty())
+                    bestFound = std::min(bestFound, trace.back().cost);
+                traces.emplace_back(&solver, seed, std::move(trace));
+                std::cerr << "." << std::flush;
+            }
+        }
+        std::cerr << "\n";
+
+        const FactoryProblem::FactoryCost reference = named.bestKnown != 0 ? named.bestKnown : bestFound;
+        for (const auto& traced : traces) {
+            for (const double gap : configuration.targetGaps) {
+                Record record;
+                record.solver = std::get<0>(traced)->name;
+                record.instance = named.name;
+                record.gap = gap;
+                record.seed = std::get<1>(traced);
+
+                const double target = reference * (1.0 + gap);
+                for (const TracePoint& point : std::get<2>(traced)) {
+                    if (point.cost <= target) {
+                        record.reached = true;
+                        record.seconds = point.seconds;
+                        record.evaluations = point.evaluations;
+                        break;
+                    }
+                }
+                records.push_back(record);
+            }
+        }
+    }
+    return records;
+}
+
+void TimeToTarget::writeRecords(std::ostream& os, const std::vector<Record>& records) {
+    os << "solver,instance,gap,seed,reached,seconds,evaluations\n";
+    os << std::setprecision(9);
+    for (const Record& record : records) {
+        os << csvField(record.solver) << "," << csvField(record.instance) << "," << record.gap << "," << record.seed << ","
+           << record.reached << "," << record.seconds << "," << record.evaluations << "\n";
+    }
+}
+
+std::vector<TimeToTarget::Record> TimeToTarget::readRecords(std::istream& is) {
+    std::vector<Record> records;
+    std::string line;
+    std::getline(is, line); // Header
+
+    // Split on commas only, instance paths may hold spaces or quoted commas
+    std::vector<std::string> fields;
+    while (std::getline(is, line)) {
+        Record record;
+        if (csvFields(line, fields) && fields.size() == 7 && parseField(fields[2], record.gap)
+            && parseField(fields[3], record.seed) && parseField(fields[4], record.reached)
+            && parseField(fields[5], record.seconds) && parseField(fields[6], record.evaluations)) {
+            record.solver = fields[0];
+            record.instance = fields[1];
+            records.push_back(record);
+        }
+    }
+    return records;
+}
+
+void TimeToTarget::report(std::ostream& os, const std::vector<Record>& records,
+    const std::vector<Record>& baseline, double significance) {
+    using Key = std::tuple<std::string, std::string, double>;
+
+    // Times per solver, instance and gap, infinite for runs missing the target
+    auto group = [](const std::vector<Record>& grouped) {
+        std::map<Key, std::vector<std::pair<double, size_t>>> groups;
+        for (const Record& record : grouped) {
+            groups[Key(record.solver, record.instance, record.gap)].emplace_back(
+                record.reached ? record.seconds : std::numeric_limits<double>::infinity(), record.evaluations);
+        }
+        return groups;
+    };
+    auto times = [](const std::vector<std::pair<double, size_t>>& runs) {
+        std::vector<double> values;
+        for (const auto& run : runs) {
+            values.push_back(run.first);
+        }
+        std::sort(std::begin(values), std::end(values));
+        return values;
+    };
+
+    const auto current = group(records);
+    const auto previous = group(baseline);
+
+    os << std::setprecision(4);
+    for (const auto& entry : current) {
+        const std::vector<double> all = times(entry.second);
+        const std::vector<double> reached(std::begin(all),
+            std::find(std::begin(all), std::end(all), std::numeric_limits<double>::infinity()));
+
+        std::vector<double> evaluations;
+        for (const auto& run : entry.second) {
+            if (run.first != std::numeric_limits<double>::infinity())
+                evaluations.push_back(static_cast<double>(run.second));
+        }
+        std::sort(std::begin(evaluations), std::end(evaluations));
+
+        os << std::get<0>(entry.first) << " " << std::get<1>(entry.first)
+           << " gap " << std::get<2>(entry.first) * 100.0 << "%: "
+           << "success " << reached.size() << "/" << all.size()
+           << ", time q10/median/q90 " << quantile(reached, 0.1) << "/" << quantile(reached, 0.5) << "/" << quantile(reached, 0.9) << " s"
+           << ", median evaluations " << quantile(evaluations, 0.5);
+
+        const auto base = previous.find(entry.first);
+        if (base != std::end(previous)) {
+            const std::vector<double> baseTimes = times(base->second);
+            const MannWhitney test = mannWhitney(all, baseTimes);
+
+            os << ", baseline median " << quantile(baseTimes, 0.5) << " s, p " << test.pValue << " ";
+            if (test.pValue >= significance)
+                os << "(no significant difference)";
+            else
+                os << (test.firstSmaller ? "(faster)" : "(slower)");
+        }
+        os << "\n";
+    }
+}
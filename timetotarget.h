@@ -0,0 +1,79 @@
+﻿//    Copyright (C) 2018 Michał Karol <michal.p.karol@gmail.com>
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef TIMETOTARGET_H
+#define TIMETOTARGET_H
+#include "factorygenetic.h"
+#include "factoryinstance.h"
+#include "paralleltempering.h"
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Time to target benchmark of whole solvers. Every solver is run with many
+// seeds on every instance and its improvements are traced, wall time and
+// evaluation count of first reaching each target gap to the best known
+// solution are derived from the traces.
+namespace TimeToTarget {
+// Gets best cost so far and number of evaluations, returns false to stop
+using Observer = std::function<bool(FactoryProblem::FactoryCost, size_t)>;
+// Runs with the seed until the observer stops it, returns the best chromosome at the end
+using Solver = std::function<FactoryProblem::FactoryChromosome(const FactoryProblem::FactoryInstance&, uint64_t, const Observer&)>;
+
+struct NamedSolver {
+    std::string name;
+    Solver solver;
+};
+
+struct NamedInstance {
+    std::string name;
+    const FactoryProblem::FactoryInstance* instance;
+    FactoryProblem::FactoryCost bestKnown; // 0 when unknown, best found is used
+};
+
+struct Configuration {
+    size_t runs = 20;
+    double timeLimit = 10.0; // Seconds per run
+    std::vector<double> targetGaps = { 0.05, 0.02, 0.01, 0.005, 0.0 };
+    double significance = 0.05;
+};
+
+// When a run first reached a target, seconds and evaluations are
+// meaningless for runs that did not reach it
+struct Record {
+    std::string solver;
+    std::string instance;
+    double gap = 0.0;
+    uint64_t seed = 0;
+    bool reached = false;
+    double seconds = 0.0;
+    size_t evaluations = 0;
+};
+
+Solver geneticSolver(const FactoryProblem::GeneticConfiguration& configuration);
+Solver temperingSolver(const ParallelTempering::Configuration& configuration);
+
+std::vector<Record> run(const std::vector<NamedSolver>& solvers, const std::vector<NamedInstance>& instances, const Configuration& configuration);
+
+void writeRecords(std::ostream& os, const std::vector<Record>& records);
+std::vector<Record> readRecords(std::istream& is);
+
+// Success rates, time to target quantiles and, when baseline records are
+// given, two sided Mann-Whitney U test of times against them with runs
+// missing the target ranked last
+void report(std::ostream& os, const std::vector<Record>& records, const std::vector<Record>& baseline, double significance);
+} // namespace TimeToTarget
+
+#endif // TIMETOTARGET_H